@@ -0,0 +1,286 @@
+#include "fuzz.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+namespace {
+
+struct stage_timings {
+    double from_als = 0.;
+    double export_container = 0.;
+    double import_container = 0.;
+    double to_als = 0.;
+};
+
+struct round_trip {
+    fmtdxc::project dxc_project;
+    fmtdxc::project imported_project;
+    fmtals::project als_project;
+    rtdxc::detail::als_identity_map identities;
+    stage_timings timings;
+};
+
+template <typename function_t>
+double measure_seconds(const function_t& function)
+{
+    const auto _start = std::chrono::steady_clock::now();
+    function();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+}
+
+[[nodiscard]] round_trip run_round_trip(const fmtals::project& als_project)
+{
+    round_trip _trip;
+    _trip.timings.from_als = measure_seconds([&]() {
+        _trip.dxc_project = rtdxc::detail::convert_from_als(als_project, _trip.identities);
+    });
+
+    std::string _container_bytes;
+    _trip.timings.export_container = measure_seconds([&]() {
+        const fmtdxc::project_container _container(_trip.dxc_project);
+        std::ostringstream _stream(std::ios::binary);
+        fmtdxc::export_container(_stream, _container, fmtdxc::version::alpha);
+        _container_bytes = _stream.str();
+    });
+
+    _trip.timings.import_container = measure_seconds([&]() {
+        std::istringstream _stream(_container_bytes, std::ios::binary);
+        fmtdxc::version _version;
+        fmtdxc::project_container _container;
+        fmtdxc::import_container(_stream, _container, _version);
+        _trip.imported_project = _container.get_project();
+    });
+
+    _trip.timings.to_als = measure_seconds([&]() {
+        _trip.als_project = rtdxc::detail::convert_to_als(_trip.imported_project, _trip.identities);
+    });
+    return _trip;
+}
+
+[[nodiscard]] std::uint64_t expected_length(const fmtals::project::audio_clip& clip)
+{
+    return clip.loop_on ? static_cast<std::uint64_t>(std::max(0.f, clip.loop_end - clip.loop_start)) : 0;
+}
+
+template <typename track_t>
+[[nodiscard]] std::string expected_name(const track_t& track)
+{
+    return track.user_name.empty() ? track.effective_name : track.user_name;
+}
+
+// Audio and midi tracks keep their order among their own kind, fmtdxc has no order across sequencer kinds
+template <typename track_t>
+[[nodiscard]] std::vector<const track_t*> get_tracks(const fmtals::project& project)
+{
+    std::vector<const track_t*> _tracks;
+    for (const auto& _track : project.tracks) {
+        if (const track_t* _typed_track = std::get_if<track_t>(&_track)) {
+            _tracks.push_back(_typed_track);
+        }
+    }
+    return _tracks;
+}
+
+// First invariant the round trip breaks, empty when every invariant holds
+[[nodiscard]] std::string check_invariants(const fmtals::project& input, round_trip& trip)
+{
+    if (serialize_project(trip.imported_project) != serialize_project(trip.dxc_project)) {
+        return "container round trip changed the project";
+    }
+
+    const std::vector<const fmtals::project::audio_track*> _input_audio = get_tracks<fmtals::project::audio_track>(input);
+    const std::vector<const fmtals::project::audio_track*> _output_audio = get_tracks<fmtals::project::audio_track>(trip.als_project);
+    const std::vector<const fmtals::project::midi_track*> _input_midi = get_tracks<fmtals::project::midi_track>(input);
+    const std::vector<const fmtals::project::midi_track*> _output_midi = get_tracks<fmtals::project::midi_track>(trip.als_project);
+    if (_output_audio.size() != _input_audio.size() || _output_midi.size() != _input_midi.size()) {
+        return "track count changed";
+    }
+    if (trip.als_project.tracks.size() != _output_audio.size() + _output_midi.size()) {
+        return "group or return tracks appeared";
+    }
+
+    for (std::size_t _track_index = 0; _track_index < _input_audio.size(); _track_index++) {
+        const fmtals::project::audio_track& _input_track = *_input_audio[_track_index];
+        const fmtals::project::audio_track& _output_track = *_output_audio[_track_index];
+        const std::string _where = "audio track " + std::to_string(_input_track.id);
+        if (_output_track.id != _input_track.id) {
+            return _where + " changed id or position";
+        }
+        if (expected_name(_output_track) != expected_name(_input_track)) {
+            return _where + " changed name";
+        }
+        if (_output_track.events_audio_clips.size() != _input_track.events_audio_clips.size()) {
+            return _where + " changed clip count";
+        }
+        for (std::size_t _clip_index = 0; _clip_index < _input_track.events_audio_clips.size(); _clip_index++) {
+            const fmtals::project::audio_clip& _input_clip = _input_track.events_audio_clips[_clip_index];
+            const fmtals::project::audio_clip& _output_clip = _output_track.events_audio_clips[_clip_index];
+            const std::string _clip_where = _where + " clip " + std::to_string(_input_clip.id);
+            if (_output_clip.id != _input_clip.id) {
+                return _clip_where + " changed id or position";
+            }
+            if (_output_clip.name != _input_clip.name) {
+                return _clip_where + " changed name";
+            }
+            if (_output_clip.time != _input_clip.time) {
+                return _clip_where + " changed time";
+            }
+            if (_output_clip.loop_on != _input_clip.loop_on) {
+                return _clip_where + " changed loop state";
+            }
+            if (static_cast<std::uint64_t>(_output_clip.loop_end - _output_clip.loop_start) != expected_length(_input_clip)) {
+                return _clip_where + " changed length";
+            }
+        }
+    }
+
+    for (std::size_t _track_index = 0; _track_index < _input_midi.size(); _track_index++) {
+        const std::string _where = "midi track " + std::to_string(_input_midi[_track_index]->id);
+        if (_output_midi[_track_index]->id != _input_midi[_track_index]->id) {
+            return _where + " changed id or position";
+        }
+        if (expected_name(*_output_midi[_track_index]) != expected_name(*_input_midi[_track_index])) {
+            return _where + " changed name";
+        }
+    }
+
+    // The exported set converts back to the same project with the same ids
+    if (serialize_project(rtdxc::detail::convert_from_als(trip.als_project, trip.identities)) != serialize_project(trip.dxc_project)) {
+        return "exported set does not convert back to the same project";
+    }
+    return {};
+}
+
+// The DAW renames a track, the session undoes it by patching the document, then the DAW saves the same rename again.
+// The second save must convert, the patched track no longer holds what the cache hashed before the undo
+[[nodiscard]] std::string check_undo_redo(const fmtals::project& input)
+{
+    const auto _is_converted = [](const auto& _track) {
+        return std::holds_alternative<fmtals::project::audio_track>(_track) || std::holds_alternative<fmtals::project::midi_track>(_track);
+    };
+    const auto _track_it = std::find_if(input.tracks.begin(), input.tracks.end(), _is_converted);
+    if (_track_it == input.tracks.end()) {
+        return {};
+    }
+    rtdxc::detail::als_identity_map _identities;
+    rtdxc::detail::als_conversion_cache _cache;
+    fmtdxc::project _original;
+    rtdxc::detail::convert_from_als(input, _identities, _cache, _original);
+
+    fmtals::project _edited = input;
+    std::visit([](auto& _track) { _track.user_name = expected_name(_track) + " edit"; }, _edited.tracks[_track_it - input.tracks.begin()]);
+    fmtdxc::project _next = _original;
+    rtdxc::detail::convert_from_als(_edited, _identities, _cache, _next);
+    const fmtdxc::project _edited_project = _next;
+    if (serialize_project(_edited_project) == serialize_project(_original)) {
+        return "edit was not converted";
+    }
+
+    fmtals::project _document = _edited;
+    rtdxc::detail::patch_als(_document, _edited_project, _original, _identities, _cache);
+    _next = _original;
+    if (serialize_project(rtdxc::detail::convert_from_als(_document, _identities)) != serialize_project(_original)) {
+        return "undo patch does not convert back to the original project";
+    }
+
+    rtdxc::detail::convert_from_als(_edited, _identities, _cache, _next);
+    if (serialize_project(_next) != serialize_project(_edited_project)) {
+        return "edit applied again after an undo was lost";
+    }
+    return {};
+}
+
+[[nodiscard]] stage_timings measure_min_timings(const fmtals::project& als_project, const std::size_t repeat_count)
+{
+    stage_timings _best = run_round_trip(als_project).timings;
+    for (std::size_t _repeat_index = 1; _repeat_index < repeat_count; _repeat_index++) {
+        const stage_timings _timings = run_round_trip(als_project).timings;
+        _best.from_als = std::min(_best.from_als, _timings.from_als);
+        _best.export_container = std::min(_best.export_container, _timings.export_container);
+        _best.import_container = std::min(_best.import_container, _timings.import_container);
+        _best.to_als = std::min(_best.to_als, _timings.to_als);
+    }
+    return _best;
+}
+
+// Fits time ~ size^exponent between the smallest and largest size, stages too fast to time reliably are skipped
+[[nodiscard]] bool check_growth(const std::string& sweep_name, const std::vector<std::size_t>& sizes, const std::vector<stage_timings>& timings, const double max_exponent)
+{
+    static constexpr double min_seconds = 1e-3;
+    const std::vector<std::pair<const char*, double stage_timings::*>> _stages = {
+        { "convert_from_als", &stage_timings::from_als },
+        { "export_container", &stage_timings::export_container },
+        { "import_container", &stage_timings::import_container },
+        { "convert_to_als", &stage_timings::to_als },
+    };
+
+    bool _is_linear = true;
+    for (const auto& [_stage_name, _member] : _stages) {
+        std::size_t _first = 0;
+        while (_first + 1 < timings.size() && timings[_first].*_member < min_seconds) {
+            _first++;
+        }
+        const std::size_t _last = timings.size() - 1;
+        std::cout << "  " << sweep_name << " " << _stage_name;
+        for (const stage_timings& _timing : timings) {
+            std::cout << " " << _timing.*_member * 1000. << "ms";
+        }
+        if (_first == _last || timings[_last].*_member < min_seconds) {
+            std::cout << " (too fast to fit)" << std::endl;
+            continue;
+        }
+        const double _exponent = std::log(timings[_last].*_member / timings[_first].*_member)
+            / std::log(static_cast<double>(sizes[_last]) / static_cast<double>(sizes[_first]));
+        const bool _is_stage_linear = _exponent <= max_exponent;
+        std::cout << " exponent " << _exponent << (_is_stage_linear ? "" : "  SUPER-LINEAR") << std::endl;
+        _is_linear &= _is_stage_linear;
+    }
+    return _is_linear;
+}
+
+}
+
+int run_fuzz(const fuzz_options& options)
+{
+    // properties, every iteration reproduces alone with --seed <seed + iteration> --fuzz 1
+    stage_timings _total;
+    for (std::size_t _iteration = 0; _iteration < options.iteration_count; _iteration++) {
+        std::mt19937_64 _random(options.seed + _iteration);
+        const fmtals::project _input = generate_random_als_project(_random, options.max_size);
+        round_trip _trip = run_round_trip(_input);
+        std::string _failure = check_invariants(_input, _trip);
+        if (_failure.empty()) {
+            _failure = check_undo_redo(_input);
+        }
+        if (!_failure.empty()) {
+            std::cout << "fuzz failed at seed " << options.seed + _iteration << " (" << _input.tracks.size() << " tracks): " << _failure << std::endl;
+            return 4;
+        }
+        _total.from_als += _trip.timings.from_als;
+        _total.export_container += _trip.timings.export_container;
+        _total.import_container += _trip.timings.import_container;
+        _total.to_als += _trip.timings.to_als;
+    }
+    const double _count = static_cast<double>(std::max<std::size_t>(1, options.iteration_count));
+    std::cout << "fuzz " << options.iteration_count << " projects from seed " << options.seed << " ok, mean"
+              << " convert_from_als " << _total.from_als / _count * 1e6 << "us"
+              << " export_container " << _total.export_container / _count * 1e6 << "us"
+              << " import_container " << _total.import_container / _count * 1e6 << "us"
+              << " convert_to_als " << _total.to_als / _count * 1e6 << "us" << std::endl;
+
+    // growth, once over the number of tracks and once over the clips of a single track
+    std::vector<std::size_t> _sizes;
+    std::vector<stage_timings> _track_timings;
+    std::vector<stage_timings> _clip_timings;
+    for (std::size_t _step = 0; _step < 5; _step++) {
+        _sizes.push_back(std::size_t(1) << _step);
+        _track_timings.push_back(measure_min_timings(generate_als_project({ std::size_t(64) << _step, 64, std::size_t(8) << _step, 16 }), 3));
+        _clip_timings.push_back(measure_min_timings(generate_als_project({ 4, std::size_t(1024) << _step, 0, 16 }), 3));
+    }
+    const bool _is_track_linear = check_growth("tracks x1..x16", _sizes, _track_timings, options.max_growth_exponent);
+    const bool _is_clip_linear = check_growth("clips x1..x16", _sizes, _clip_timings, options.max_growth_exponent);
+    return _is_track_linear && _is_clip_linear ? 0 : 5;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include "generator.hpp"
+
+struct fuzz_options {
+    std::uint64_t seed = 1;
+    std::size_t iteration_count = 1000;
+    generator_options max_size = { 32, 32, 8, 24 };
+    double max_growth_exponent = 1.5; // time(2n) / time(n) above 2^exponent flags a stage as super-linear
+};
+
+/// @brief pushes random ALS projects through convert_from_als, export_container, import_container and convert_to_als,
+/// checks the round trip invariants and that an edit undone with patch_als converts again when the DAW saves it anew,
+/// then checks the growth of every stage over doubling project sizes
+/// @param options
+/// @return 0 when every invariant held and no stage grew super-linearly
+[[nodiscard]] int run_fuzz(const fuzz_options& options);
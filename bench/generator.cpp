@@ -0,0 +1,206 @@
+#include "generator.hpp"
+
+#include <cereal/archives/binary.hpp>
+
+#include <sstream>
+
+namespace {
+
+[[nodiscard]] std::string make_name(const std::string& prefix, const std::size_t index, const std::size_t length)
+{
+    std::string _name = prefix + " " + std::to_string(index);
+    if (_name.size() < length) {
+        _name.append(length - _name.size(), '-');
+    }
+    return _name;
+}
+
+[[nodiscard]] std::string make_random_name(std::mt19937_64& random, const std::size_t max_length)
+{
+    static const std::vector<std::string> _pieces = { "a", "Z", "0", " ", "-", "_", "&", "<", ">", "\"", "'", "\xc3\xa9", "\xe9\x9f\xb3", "\xf0\x9f\x8e\xb9" };
+    std::uniform_int_distribution<std::size_t> _length_distribution(0, max_length);
+    std::uniform_int_distribution<std::size_t> _piece_distribution(0, _pieces.size() - 1);
+    const std::size_t _length = _length_distribution(random);
+    std::string _name;
+    while (_name.size() < _length) {
+        _name += _pieces[_piece_distribution(random)];
+    }
+    return _name;
+}
+
+// Ids grow by random gaps so that nothing can rely on them being dense
+[[nodiscard]] unsigned int next_sparse_id(std::mt19937_64& random, unsigned int& id)
+{
+    id += std::uniform_int_distribution<unsigned int>(1, 16)(random);
+    return id;
+}
+
+}
+
+fmtals::project generate_als_project(const generator_options& options)
+{
+    fmtals::project _project {};
+    _project.tracks.reserve(options.audio_track_count + options.midi_track_count);
+    unsigned int _track_id = 1;
+    unsigned int _clip_id = 1;
+    for (std::size_t _track_index = 0; _track_index < options.audio_track_count; _track_index++) {
+        fmtals::project::audio_track _track {};
+        _track.id = _track_id++;
+        _track.effective_name = make_name("Audio", _track_index, options.name_length);
+        _track.events_audio_clips.reserve(options.clips_per_track);
+        for (std::size_t _clip_index = 0; _clip_index < options.clips_per_track; _clip_index++) {
+            fmtals::project::audio_clip _clip {};
+            _clip.id = _clip_id++;
+            _clip.name = make_name("Clip", _clip_index, options.name_length);
+            _clip.time = static_cast<unsigned int>(_clip_index * 960);
+            _clip.loop_on = true;
+            _clip.loop_end = 960.f;
+            _track.events_audio_clips.push_back(std::move(_clip));
+        }
+        _project.tracks.push_back(std::move(_track));
+    }
+
+    // midi clips and notes aren't carried by either schema yet, midi tracks only weigh by their names
+    for (std::size_t _track_index = 0; _track_index < options.midi_track_count; _track_index++) {
+        fmtals::project::midi_track _track {};
+        _track.id = _track_id++;
+        _track.effective_name = make_name("Midi", _track_index, options.name_length);
+        _project.tracks.push_back(std::move(_track));
+    }
+    return _project;
+}
+
+fmtals::project generate_random_als_project(std::mt19937_64& random, const generator_options& options)
+{
+    std::uniform_int_distribution<std::size_t> _track_distribution(0, options.audio_track_count + options.midi_track_count);
+    std::uniform_int_distribution<std::size_t> _clip_distribution(0, options.clips_per_track);
+    std::uniform_int_distribution<unsigned int> _kind_distribution(0, 9);
+    std::uniform_real_distribution<float> _position_distribution(0.f, 4096.f);
+    std::bernoulli_distribution _coin_distribution(0.5);
+
+    fmtals::project _project {};
+    unsigned int _track_id = 0;
+    unsigned int _clip_id = 0;
+    const std::size_t _track_count = _track_distribution(random);
+    for (std::size_t _track_index = 0; _track_index < _track_count; _track_index++) {
+        const unsigned int _kind = _kind_distribution(random);
+        if (_kind < 6) {
+            fmtals::project::audio_track _track {};
+            _track.id = next_sparse_id(random, _track_id);
+            _track.effective_name = make_random_name(random, options.name_length);
+            _track.user_name = _coin_distribution(random) ? make_random_name(random, options.name_length) : std::string();
+            const std::size_t _clip_count = _clip_distribution(random);
+            for (std::size_t _clip_index = 0; _clip_index < _clip_count; _clip_index++) {
+                fmtals::project::audio_clip _clip {};
+                _clip.id = next_sparse_id(random, _clip_id);
+                _clip.name = make_random_name(random, options.name_length);
+                _clip.time = static_cast<unsigned int>(random() % (1u << 24));
+                _clip.loop_on = _coin_distribution(random);
+                _clip.loop_start = _position_distribution(random);
+                _clip.loop_end = _coin_distribution(random) ? _clip.loop_start + _position_distribution(random) : _position_distribution(random);
+                _clip.current_start = _clip.loop_start;
+                _clip.current_end = _clip.loop_end;
+                _track.events_audio_clips.push_back(std::move(_clip));
+            }
+            _project.tracks.push_back(std::move(_track));
+        } else if (_kind < 8) {
+            fmtals::project::midi_track _track {};
+            _track.id = next_sparse_id(random, _track_id);
+            _track.effective_name = make_random_name(random, options.name_length);
+            _track.user_name = _coin_distribution(random) ? make_random_name(random, options.name_length) : std::string();
+            _project.tracks.push_back(std::move(_track));
+        } else if (_kind < 9) {
+            fmtals::project::group_track _track {};
+            _track.id = next_sparse_id(random, _track_id);
+            _track.effective_name = make_random_name(random, options.name_length);
+            _project.tracks.push_back(std::move(_track));
+        } else {
+            fmtals::project::return_track _track {};
+            _track.id = next_sparse_id(random, _track_id);
+            _track.effective_name = make_random_name(random, options.name_length);
+            _project.tracks.push_back(std::move(_track));
+        }
+    }
+    return _project;
+}
+
+fmtdxc::project generate_dxc_project(const generator_options& options)
+{
+    fmtdxc::project _project {};
+    _project.name = make_name("Project", 0, options.name_length);
+    _project.ppq = 960;
+    _project.master_track_id = 1;
+    _project.mixer_tracks[1] = fmtdxc::project::mixer_track { "Master", 0.0, 0.0 };
+
+    std::uint32_t _mixer_track_id = 2;
+    std::uint32_t _clip_id = 1;
+    for (std::size_t _track_index = 0; _track_index < options.audio_track_count; _track_index++) {
+        const std::uint32_t _sequencer_id = static_cast<std::uint32_t>(_track_index + 1);
+        fmtdxc::project::mixer_track& _mixer_track = _project.mixer_tracks[_mixer_track_id];
+        _mixer_track.name = make_name("Audio", _track_index, options.name_length);
+        fmtdxc::project::audio_sequencer& _sequencer = _project.audio_sequencers[_sequencer_id];
+        _sequencer.name = _mixer_track.name;
+        _sequencer.output = _mixer_track_id++;
+        for (std::size_t _clip_index = 0; _clip_index < options.clips_per_track; _clip_index++) {
+            fmtdxc::project::audio_clip& _clip = _sequencer.clips[_clip_id++];
+            _clip.name = make_name("Clip", _clip_index, options.name_length);
+            _clip.start_tick = _clip_index * 960;
+            _clip.length_ticks = 960;
+            _clip.is_loop = true;
+        }
+    }
+    for (std::size_t _track_index = 0; _track_index < options.midi_track_count; _track_index++) {
+        const std::uint32_t _sequencer_id = static_cast<std::uint32_t>(_track_index + 1);
+        fmtdxc::project::mixer_track& _mixer_track = _project.mixer_tracks[_mixer_track_id];
+        _mixer_track.name = make_name("Midi", _track_index, options.name_length);
+        fmtdxc::project::midi_sequencer& _sequencer = _project.midi_sequencers[_sequencer_id];
+        _sequencer.name = _mixer_track.name;
+        _sequencer.instrument.name = "Instrument";
+        _sequencer.output = _mixer_track_id++;
+    }
+    return _project;
+}
+
+void mutate_dxc_project(fmtdxc::project& project, const std::size_t stride)
+{
+    std::size_t _index = 0;
+    std::size_t _mutation_index = 0;
+    for (auto& [_sequencer_id, _sequencer] : project.audio_sequencers) {
+        for (auto _clip_it = _sequencer.clips.begin(); _clip_it != _sequencer.clips.end();) {
+            if (_index++ % stride != 0) {
+                ++_clip_it;
+                continue;
+            }
+            switch (_mutation_index++ % 3) {
+            case 0:
+                _clip_it->second.name += " (edit)";
+                ++_clip_it;
+                break;
+            case 1:
+                _clip_it->second.start_tick += 480;
+                ++_clip_it;
+                break;
+            default:
+                _clip_it = _sequencer.clips.erase(_clip_it);
+                break;
+            }
+        }
+    }
+}
+
+std::string serialize_project(const fmtdxc::project& project)
+{
+    std::ostringstream _stream(std::ios::binary);
+    {
+        cereal::BinaryOutputArchive _archive(_stream);
+        _archive(project);
+    }
+    return _stream.str();
+}
+
+std::string serialize_project(const fmtals::project& project)
+{
+    std::ostringstream _stream(std::ios::binary);
+    fmtals::export_project(_stream, project, fmtals::version::v_9_0_0);
+    return _stream.str();
+}
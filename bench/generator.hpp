@@ -0,0 +1,38 @@
+#pragma once
+
+#include <rtdxc/rtdxc.hpp>
+
+#include <random>
+
+struct generator_options {
+    std::size_t audio_track_count = 1000;
+    std::size_t clips_per_track = 100;
+    std::size_t midi_track_count = 100;
+    std::size_t name_length = 16;
+};
+
+/// @brief builds an ALS project with audio tracks of clips_per_track clips each followed by midi tracks,
+/// every track and clip name padded to name_length characters
+/// @param options
+[[nodiscard]] fmtals::project generate_als_project(const generator_options& options);
+
+/// @brief builds the fmtdxc project of the same shape directly, without going through the converter
+/// @param options
+[[nodiscard]] fmtdxc::project generate_dxc_project(const generator_options& options);
+
+/// @brief builds a random ALS project no larger than options, with sparse unique ids, group and return tracks,
+/// empty user names and names full of characters that need escaping
+/// @param random
+/// @param options
+[[nodiscard]] fmtals::project generate_random_als_project(std::mt19937_64& random, const generator_options& options);
+
+/// @brief renames, moves or removes every stride-th clip of the project to give diffs and patches some work
+/// @param project
+/// @param stride
+void mutate_dxc_project(fmtdxc::project& project, const std::size_t stride);
+
+/// @brief cereal binary bytes of the project, equal bytes mean equal projects
+[[nodiscard]] std::string serialize_project(const fmtdxc::project& project);
+
+/// @brief exported ALS bytes of the project
+[[nodiscard]] std::string serialize_project(const fmtals::project& project);
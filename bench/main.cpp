@@ -0,0 +1,590 @@
+#include "fuzz.hpp"
+#include "generator.hpp"
+#include "metrics.hpp"
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/map.hpp>
+#include <cereal/types/optional.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/utility.hpp>
+#include <cereal/types/vector.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+struct benchmark_result {
+    double nanoseconds = 0.;
+    double allocations = 0.;
+    double allocated_bytes = 0.;
+};
+
+// Runs setup then function repeat_count times, only function is timed and counted
+template <typename setup_t, typename function_t>
+[[nodiscard]] benchmark_result run_benchmark(const std::size_t repeat_count, const setup_t& setup, const function_t& function)
+{
+    benchmark_result _result;
+    for (std::size_t _index = 0; _index < repeat_count; _index++) {
+        setup();
+        const allocation_counters _allocations_before = get_allocation_counters();
+        const auto _start = std::chrono::steady_clock::now();
+        function();
+        const auto _stop = std::chrono::steady_clock::now();
+        const allocation_counters _allocations_after = get_allocation_counters();
+        _result.nanoseconds += std::chrono::duration<double, std::nano>(_stop - _start).count();
+        _result.allocations += static_cast<double>(_allocations_after.count - _allocations_before.count);
+        _result.allocated_bytes += static_cast<double>(_allocations_after.bytes - _allocations_before.bytes);
+    }
+    _result.nanoseconds /= static_cast<double>(repeat_count);
+    _result.allocations /= static_cast<double>(repeat_count);
+    _result.allocated_bytes /= static_cast<double>(repeat_count);
+    return _result;
+}
+
+template <typename function_t>
+[[nodiscard]] benchmark_result run_benchmark(const std::size_t repeat_count, const function_t& function)
+{
+    return run_benchmark(repeat_count, []() { }, function);
+}
+
+void print_result(const std::string& name, const benchmark_result& result)
+{
+    std::cout << "  " << std::left << std::setw(32) << name << std::right
+              << std::setw(16) << std::fixed << std::setprecision(0) << result.nanoseconds << " ns/op"
+              << std::setw(12) << result.allocations << " allocs/op"
+              << std::setw(14) << result.allocated_bytes << " B/op" << std::endl;
+}
+
+void print_rate(const std::string& name, const double messages_per_second, const double bytes_per_second)
+{
+    std::cout << "  " << std::left << std::setw(32) << name << std::right
+              << std::setw(16) << std::fixed << std::setprecision(0) << messages_per_second << " msg/s"
+              << std::setw(12) << bytes_per_second / (1024. * 1024.) << " MiB/s" << std::endl;
+}
+
+// Spins until is_done or the timeout, the p2p threads make progress on their own
+template <typename predicate_t>
+[[nodiscard]] bool wait_until(const predicate_t& is_done, const std::chrono::seconds timeout)
+{
+    const auto _deadline = std::chrono::steady_clock::now() + timeout;
+    while (!is_done()) {
+        if (std::chrono::steady_clock::now() > _deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    return true;
+}
+
+void print_usage()
+{
+    std::cout << "Usage: rtdxc_bench [--audio-tracks N] [--clips N] [--midi-tracks N] [--name-length N] [--repeats N]" << std::endl;
+    std::cout << "       rtdxc_bench --fuzz N [--seed S]" << std::endl;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    generator_options _options;
+    std::size_t _repeat_count = 5;
+    std::optional<fuzz_options> _fuzz_options;
+    std::uint64_t _seed = 1;
+    for (int _arg_index = 1; _arg_index < argc; _arg_index += 2) {
+        if (_arg_index + 1 >= argc) {
+            print_usage();
+            return 1;
+        }
+        const std::size_t _value = std::stoul(argv[_arg_index + 1]);
+        if (!std::strcmp(argv[_arg_index], "--audio-tracks")) {
+            _options.audio_track_count = _value;
+        } else if (!std::strcmp(argv[_arg_index], "--clips")) {
+            _options.clips_per_track = _value;
+        } else if (!std::strcmp(argv[_arg_index], "--midi-tracks")) {
+            _options.midi_track_count = _value;
+        } else if (!std::strcmp(argv[_arg_index], "--name-length")) {
+            _options.name_length = _value;
+        } else if (!std::strcmp(argv[_arg_index], "--repeats")) {
+            _repeat_count = _value ? _value : 1;
+        } else if (!std::strcmp(argv[_arg_index], "--fuzz")) {
+            _fuzz_options = fuzz_options {};
+            _fuzz_options->iteration_count = _value;
+        } else if (!std::strcmp(argv[_arg_index], "--seed")) {
+            _seed = std::stoull(argv[_arg_index + 1]);
+        } else {
+            print_usage();
+            return 1;
+        }
+    }
+
+    if (_fuzz_options) {
+        _fuzz_options->seed = _seed;
+        return run_fuzz(_fuzz_options.value());
+    }
+
+    const std::size_t _clip_count = _options.audio_track_count * _options.clips_per_track;
+    std::cout << "project " << _options.audio_track_count << " audio tracks / " << _clip_count << " clips / "
+              << _options.midi_track_count << " midi tracks / names of " << _options.name_length << " chars, "
+              << _repeat_count << " repeats" << std::endl;
+
+    const fmtals::project _als_project = generate_als_project(_options);
+    const fmtdxc::project _dxc_project = generate_dxc_project(_options);
+    fmtdxc::project _mutated_dxc_project = _dxc_project;
+    mutate_dxc_project(_mutated_dxc_project, 7);
+
+    // converters
+    {
+        fmtdxc::project _from_als;
+        print_result("convert_from_als", run_benchmark(_repeat_count, [&]() {
+            _from_als = rtdxc::detail::convert_from_als(_als_project);
+        }));
+
+        rtdxc::detail::als_identity_map _identities;
+        rtdxc::detail::als_conversion_cache _cache;
+        rtdxc::detail::convert_from_als(_als_project, _identities, _cache, _from_als);
+        print_result("convert_from_als (unchanged)", run_benchmark(_repeat_count, [&]() {
+            rtdxc::detail::convert_from_als(_als_project, _identities, _cache, _from_als);
+        }));
+
+        fmtals::project _to_als;
+        print_result("convert_to_als", run_benchmark(_repeat_count, [&]() {
+            _to_als = rtdxc::detail::convert_to_als(_dxc_project);
+        }));
+
+        rtdxc::detail::als_identity_map _patch_identities;
+        const fmtals::project _base_als = rtdxc::detail::convert_to_als(_dxc_project, _patch_identities);
+        rtdxc::detail::als_identity_map _identities_copy;
+        print_result("patch_als", run_benchmark(_repeat_count, [&]() {
+            _to_als = _base_als;
+            _identities_copy = _patch_identities;
+        }, [&]() {
+            rtdxc::detail::patch_als(_to_als, _dxc_project, _mutated_dxc_project, _identities_copy);
+        }));
+    }
+
+    // converters on a scratch arena, warmed once so it has grown to the event size like in a session
+    {
+        rtdxc::detail::scratch_arena _arena(1 << 16);
+        const auto _reset_arena = [&]() { _arena.reset(); };
+        const auto _arena_options = [&]() { return rtdxc::detail::conversion_options { 1, _arena.get_resource() }; };
+
+        rtdxc::detail::als_identity_map _identities;
+        rtdxc::detail::als_conversion_cache _cache;
+        fmtdxc::project _from_als;
+        rtdxc::detail::convert_from_als(_als_project, _identities, _cache, _from_als, _arena_options());
+        rtdxc::detail::convert_from_als(_als_project, _identities, _cache, _from_als, _arena_options());
+        _arena.reset();
+        print_result("convert_from_als (unchanged, arena)", run_benchmark(_repeat_count, _reset_arena, [&]() {
+            rtdxc::detail::convert_from_als(_als_project, _identities, _cache, _from_als, _arena_options());
+        }));
+
+        fmtals::project _to_als = rtdxc::detail::convert_to_als(_dxc_project, _arena_options());
+        _arena.reset();
+        print_result("convert_to_als (arena)", run_benchmark(_repeat_count, _reset_arena, [&]() {
+            _to_als = rtdxc::detail::convert_to_als(_dxc_project, _arena_options());
+        }));
+
+        rtdxc::detail::als_identity_map _patch_identities;
+        const fmtals::project _base_als = rtdxc::detail::convert_to_als(_dxc_project, _patch_identities);
+        rtdxc::detail::als_identity_map _identities_copy = _patch_identities;
+        _to_als = _base_als;
+        rtdxc::detail::patch_als(_to_als, _dxc_project, _mutated_dxc_project, _identities_copy, _arena_options());
+        print_result("patch_als (arena)", run_benchmark(_repeat_count, [&]() {
+            _to_als = _base_als;
+            _identities_copy = _patch_identities;
+            _arena.reset();
+        }, [&]() {
+            rtdxc::detail::patch_als(_to_als, _dxc_project, _mutated_dxc_project, _identities_copy, _arena_options());
+        }));
+        std::cout << "  arena capacity " << _arena.get_capacity() << " bytes" << std::endl;
+    }
+
+    // names, a commit patch of every entity as journals and join replies carry it, its names interned once in the table
+    {
+        rtdxc::detail::entity_changes _all_entities;
+        std::size_t _name_count = 0;
+        std::size_t _raw_bytes = _dxc_project.name.size();
+        for (const auto& [_mixer_track_id, _mixer_track] : _dxc_project.mixer_tracks) {
+            _all_entities.mixer_tracks.insert(_mixer_track_id);
+            _raw_bytes += _mixer_track.name.size();
+            _name_count++;
+        }
+        for (const auto& [_sequencer_id, _sequencer] : _dxc_project.audio_sequencers) {
+            _all_entities.audio_sequencers.insert(_sequencer_id);
+            _raw_bytes += _sequencer.name.size();
+            _name_count++;
+            for (const auto& [_clip_id, _clip] : _sequencer.clips) {
+                _raw_bytes += _clip.name.size();
+                _name_count++;
+            }
+        }
+        for (const auto& [_sequencer_id, _sequencer] : _dxc_project.midi_sequencers) {
+            _all_entities.midi_sequencers.insert(_sequencer_id);
+            _raw_bytes += _sequencer.name.size() + _sequencer.instrument.name.size();
+            _name_count += 2;
+        }
+
+        rtdxc::detail::symbol_table _symbols;
+        rtdxc::detail::commit_patch _patch;
+        print_result("make_commit_patch (every entity)", run_benchmark(_repeat_count, [&]() {
+            _patch = rtdxc::detail::make_commit_patch("bench", _dxc_project, _all_entities, _symbols);
+        }));
+        fmtdxc::project_container _container(fmtdxc::project {});
+        print_result("apply_commit_patch (every entity)", run_benchmark(_repeat_count, [&]() {
+            rtdxc::detail::apply_commit_patch(_patch, _symbols, _container);
+        }));
+        std::ostringstream _stream(std::ios::binary);
+        {
+            cereal::BinaryOutputArchive _archive(_stream);
+            _archive(_patch);
+        }
+        std::cout << "  " << _name_count << " names (" << _raw_bytes << " bytes), " << _symbols.get_count() << " symbols ("
+                  << _symbols.get_text_bytes() << " bytes, sent once), patch " << _stream.str().size() << " bytes, project "
+                  << serialize_project(_dxc_project).size() << " bytes" << std::endl;
+    }
+
+    // containers
+    {
+        const fmtdxc::project_container _container(_dxc_project);
+        std::string _container_bytes;
+        print_result("export_container", run_benchmark(_repeat_count, [&]() {
+            std::ostringstream _stream(std::ios::binary);
+            fmtdxc::export_container(_stream, _container, fmtdxc::version::alpha);
+            _container_bytes = _stream.str();
+        }));
+
+        print_result("import_container", run_benchmark(_repeat_count, [&]() {
+            std::istringstream _stream(_container_bytes, std::ios::binary);
+            fmtdxc::version _version;
+            fmtdxc::project_container _imported;
+            fmtdxc::import_container(_stream, _imported, _version);
+        }));
+        std::cout << "  container size " << _container_bytes.size() << " bytes" << std::endl;
+
+        // persisting one commit, a journal appends what it wrote where saving writes the whole container again
+        const std::filesystem::path _journaled_path = std::filesystem::temp_directory_path() / "rtdxc_bench.dxcc";
+        {
+            std::ofstream _stream(_journaled_path, std::ios::binary);
+            _stream << _container_bytes;
+        }
+        {
+            fmtdxc::project_container _journaled;
+            rtdxc::detail::container_journal _journal(_journaled_path, _journaled, std::chrono::milliseconds(0));
+            rtdxc::detail::entity_changes _changes;
+            _changes.audio_sequencers.insert(_dxc_project.audio_sequencers.begin()->first);
+            print_result("journal commit + flush", run_benchmark(_repeat_count, [&]() {
+                _journal.append_commit("bench", _dxc_project, _changes);
+                _journal.flush();
+            }));
+            std::cout << "  " << _journal.get_journal_bytes() / _repeat_count << " bytes per commit, "
+                      << _journal.get_sync_count() << " syncs" << std::endl;
+        }
+        std::filesystem::remove(_journaled_path);
+        std::filesystem::remove(std::filesystem::path(_journaled_path).concat(".journal"));
+    }
+
+    // diff
+    {
+        fmtdxc::sparse_project _diff;
+        print_result("diff (unchanged)", run_benchmark(_repeat_count, [&]() {
+            _diff = fmtdxc::sparse_project {};
+            fmtdxc::diff(_dxc_project, _dxc_project, _diff);
+        }));
+        print_result("diff (1 clip in 7 changed)", run_benchmark(_repeat_count, [&]() {
+            _diff = fmtdxc::sparse_project {};
+            fmtdxc::diff(_dxc_project, _mutated_dxc_project, _diff);
+        }));
+
+        // hashed, as a session diffs its next project against the head with the entities the converter touched
+        rtdxc::detail::project_hashes _hashes;
+        print_result("hash_project", run_benchmark(_repeat_count, [&]() {
+            rtdxc::detail::hash_project(_dxc_project, _hashes);
+        }));
+        rtdxc::detail::project_hashes _mutated_hashes;
+        rtdxc::detail::hash_project(_mutated_dxc_project, _mutated_hashes);
+        rtdxc::detail::entity_changes _all_sequencers;
+        for (const auto& [_sequencer_id, _sequencer] : _dxc_project.audio_sequencers) {
+            _all_sequencers.audio_sequencers.insert(_sequencer_id);
+        }
+
+        fmtdxc::project _one_changed_project = _dxc_project;
+        rtdxc::detail::entity_changes _one_changed;
+        if (!_one_changed_project.audio_sequencers.empty()) {
+            auto& [_sequencer_id, _sequencer] = *_one_changed_project.audio_sequencers.begin();
+            _sequencer.name += " (edit)";
+            _one_changed.audio_sequencers.insert(_sequencer_id);
+        }
+        rtdxc::detail::project_hashes _one_changed_hashes = _hashes;
+        print_result("rehash_project (1 sequencer)", run_benchmark(_repeat_count, [&]() {
+            rtdxc::detail::rehash_project(_one_changed_project, _one_changed, _one_changed_hashes);
+        }));
+
+        print_result("diff hashed (unchanged)", run_benchmark(_repeat_count, [&]() {
+            _diff = fmtdxc::sparse_project {};
+            rtdxc::detail::diff(_dxc_project, _hashes, _dxc_project, _hashes, _all_sequencers, _diff);
+        }));
+        print_result("diff hashed (1 sequencer changed)", run_benchmark(_repeat_count, [&]() {
+            _diff = fmtdxc::sparse_project {};
+            rtdxc::detail::diff(_dxc_project, _hashes, _one_changed_project, _one_changed_hashes, _one_changed, _diff);
+        }));
+        print_result("diff hashed (1 clip in 7 changed)", run_benchmark(_repeat_count, [&]() {
+            _diff = fmtdxc::sparse_project {};
+            rtdxc::detail::diff(_dxc_project, _hashes, _mutated_dxc_project, _mutated_hashes, _all_sequencers, _diff);
+        }));
+    }
+
+    // history, one renamed sequencer per commit, rebuilding the state right before a checkpoint so that it replays interval - 1 commits
+    {
+        static constexpr std::size_t commit_count = 64;
+        std::vector<fmtdxc::project> _states = { _dxc_project };
+        std::vector<rtdxc::detail::entity_changes> _changes(commit_count + 1);
+        auto _sequencer_it = _dxc_project.audio_sequencers.begin();
+        for (std::size_t _index = 1; _index <= commit_count && _sequencer_it != _dxc_project.audio_sequencers.end(); _index++, ++_sequencer_it) {
+            fmtdxc::project& _state = _states.emplace_back(_states.back());
+            _state.audio_sequencers.at(_sequencer_it->first).name += " (edit)";
+            _changes[_index].audio_sequencers.insert(_sequencer_it->first);
+        }
+        std::size_t _project_copy_bytes = 0;
+        {
+            const allocation_counters _allocations_before = get_allocation_counters();
+            const fmtdxc::project _copy = _dxc_project;
+            _project_copy_bytes = get_allocation_counters().live_bytes - _allocations_before.live_bytes;
+        }
+        for (const std::size_t _interval : { std::size_t(4), std::size_t(16), std::size_t(64) }) {
+            const allocation_counters _allocations_before = get_allocation_counters();
+            rtdxc::detail::project_history _history(_states.front(), 0, _interval, 0); // uncached, every call rebuilds
+            for (std::size_t _index = 1; _index < _states.size(); _index++) {
+                _history.commit(_index, _states[_index], _changes[_index], std::chrono::system_clock::time_point());
+            }
+            const allocation_counters _allocations_after = get_allocation_counters();
+            std::shared_ptr<const fmtdxc::project> _rebuilt;
+            print_result("history get_project (interval " + std::to_string(_interval) + ")", run_benchmark(_repeat_count, [&]() {
+                _rebuilt = _history.get_project(_history.get_last_index() - 1);
+            }));
+            std::cout << "  " << _history.get_checkpoint_count() << " checkpoints, "
+                      << (_allocations_after.live_bytes - _allocations_before.live_bytes) / 1024 << " KiB held for "
+                      << _states.size() << " states, a project copy holds " << _project_copy_bytes / 1024 << " KiB" << std::endl;
+        }
+
+        // browsing every state in order, only the last ones stay cached so each pass builds them all again
+        rtdxc::detail::project_history _history(_states.front(), 0, 64, 8);
+        for (std::size_t _index = 1; _index < _states.size(); _index++) {
+            _history.commit(_index, _states[_index], _changes[_index], std::chrono::system_clock::time_point());
+        }
+        std::size_t _checksum = 0;
+        print_result("history browse all states (cached)", run_benchmark(_repeat_count, [&]() {
+            for (std::size_t _index = 0; _index <= _history.get_last_index(); _index++) {
+                _checksum += _history.get_project(_index)->audio_sequencers.size();
+            }
+        }));
+        std::cout << "  " << _history.get_cached_count() << " states cached (checksum " << _checksum << ")" << std::endl;
+
+        // everything a session holds after as many saves of the set, each renaming one track and committed as the session does
+        const allocation_counters _allocations_before = get_allocation_counters();
+        fmtals::project _set = _als_project;
+        rtdxc::detail::als_identity_map _identities;
+        rtdxc::detail::als_conversion_cache _cache;
+        fmtdxc::project_container _container;
+        rtdxc::detail::project_history _session_history(_container.get_project(), 0, 64, 0);
+        std::optional<rtdxc::detail::working_project> _head_proj(std::in_place, _session_history, 0);
+        rtdxc::detail::working_project _next_proj(_session_history, 0);
+        rtdxc::detail::project_hashes _head_hashes;
+        rtdxc::detail::hash_project(_container.get_project(), _head_hashes);
+        rtdxc::detail::project_hashes _next_hashes = _head_hashes;
+        std::size_t _container_bytes = 0;
+        for (std::size_t _save_index = 0; _save_index <= commit_count && !_set.tracks.empty(); _save_index++) {
+            if (_save_index) {
+                std::visit([&](auto& _track) { _track.user_name = "Edit " + std::to_string(_save_index); }, _set.tracks[_save_index % _set.tracks.size()]);
+            }
+            rtdxc::detail::convert_from_als(_set, _identities, _cache, _next_proj);
+            rtdxc::detail::rehash_project(_next_proj.materialize(_cache.changes), _cache.changes, _next_hashes);
+            const rtdxc::detail::entity_changes _changes = rtdxc::detail::get_changed_entities(_head_hashes, _next_hashes, _cache.changes);
+            const std::size_t _container_before = get_allocation_counters().live_bytes;
+            _container.commit("save " + std::to_string(_save_index), _next_proj.materialize());
+            _container_bytes += get_allocation_counters().live_bytes - _container_before;
+            _session_history.commit(_container.get_applied_count(), _next_proj, _changes, std::chrono::system_clock::time_point());
+            _head_proj.emplace(_session_history, _container.get_applied_count());
+            _head_hashes = _next_hashes;
+        }
+        const std::size_t _session_bytes = get_allocation_counters().live_bytes - _allocations_before.live_bytes;
+        std::cout << "  session footprint " << _session_bytes / 1024 << " KiB after " << _container.get_applied_count()
+                  << " commits, of which the container holds " << _container_bytes / 1024 << " KiB, a project copy holds "
+                  << _project_copy_bytes / 1024 << " KiB" << std::endl;
+    }
+
+    // p2p over loopback, from the first send to the last message received. every message must arrive once and in order
+    {
+        rtdxc::detail::p2p_host _host("127.0.0.1", 0);
+        std::atomic<std::size_t> _connected_count = 0;
+        _host.on_connect([&](const rtdxc::detail::p2p_client_id) {
+            _connected_count++;
+        });
+        natp2p::endpoint_data _host_endpoint;
+        _host_endpoint.type = natp2p::endpoint_type::ipv4_lan;
+        _host_endpoint.external_ip = "127.0.0.1";
+        _host_endpoint.external_port = _host.get_port();
+        rtdxc::detail::p2p_client _client(_host_endpoint);
+
+        std::atomic<std::uint64_t> _received_count = 0;
+        std::atomic<bool> _is_ordered = true;
+        const auto _count_received = [&](const std::vector<std::uint8_t>& _payload) {
+            std::uint64_t _sequence = 0;
+            std::memcpy(&_sequence, _payload.data(), sizeof(_sequence));
+            if (_sequence != _received_count.load(std::memory_order_relaxed)) {
+                _is_ordered = false;
+            }
+            _received_count.fetch_add(1, std::memory_order_release);
+        };
+        _host.on_receive([&](const rtdxc::detail::p2p_client_id, const std::vector<std::uint8_t>& _payload) {
+            _count_received(_payload);
+        });
+        _client.on_receive(_count_received);
+        const bool _is_connected = wait_until([&]() { return _connected_count.load() == 1; }, std::chrono::seconds(5));
+
+        for (const std::size_t _payload_size : { std::size_t(64), std::size_t(4096) }) {
+            const std::uint64_t _message_count = std::min<std::uint64_t>(100000, (64 << 20) / _payload_size); // ENet queues what is sent ahead
+            for (const bool _is_broadcast : { false, true }) {
+                _received_count = 0;
+                std::vector<std::uint8_t> _payload(_payload_size);
+                const auto _start = std::chrono::steady_clock::now();
+                for (std::uint64_t _sequence = 0; _sequence < _message_count; _sequence++) {
+                    std::memcpy(_payload.data(), &_sequence, sizeof(_sequence));
+                    if (_is_broadcast) {
+                        _host.broadcast(_payload);
+                    } else {
+                        _client.send(_payload);
+                    }
+                }
+                const bool _is_received = _is_connected && wait_until([&]() { return _received_count.load(std::memory_order_acquire) == _message_count; }, std::chrono::seconds(60));
+                const double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+                if (!_is_received || !_is_ordered) {
+                    std::cout << "  P2P LOOPBACK LOST OR REORDERED MESSAGES, " << _received_count.load() << " of " << _message_count << " received" << std::endl;
+                    return 2;
+                }
+                print_rate(std::string(_is_broadcast ? "p2p host broadcast" : "p2p client send") + " (" + std::to_string(_payload_size) + " B)",
+                    static_cast<double>(_message_count) / _seconds, static_cast<double>(_message_count * _payload_size) / _seconds);
+            }
+        }
+
+        // compression of project bodies as the peers count it, the payloads above are mostly zeros
+        const std::string _body = serialize_project(_dxc_project);
+        const std::vector<std::uint8_t> _body_payload(_body.begin(), _body.end());
+        const std::uint64_t _body_count = 64;
+        std::atomic<std::uint64_t> _received_bodies = 0;
+        _host.on_receive([&](const rtdxc::detail::p2p_client_id, const std::vector<std::uint8_t>& _payload) {
+            if (_payload != _body_payload) {
+                _is_ordered = false;
+            }
+            _received_bodies.fetch_add(1, std::memory_order_release);
+        });
+        const rtdxc::detail::p2p_peer_info _sent_before = _client.get_host_info();
+        const rtdxc::detail::p2p_peer_info _received_before = _host.get_client_info(_client.get_id());
+        for (std::uint64_t _index = 0; _index < _body_count; _index++) {
+            _client.send(_body_payload);
+        }
+        const std::uint64_t _body_bytes = _body_count * _body_payload.size();
+        const bool _is_body_received = wait_until([&]() {
+            return _received_bodies.load(std::memory_order_acquire) == _body_count
+                && _client.get_host_info().sent_payload_bytes - _sent_before.sent_payload_bytes == _body_bytes
+                && _host.get_client_info(_client.get_id()).received_payload_bytes - _received_before.received_payload_bytes == _body_bytes;
+        },
+            std::chrono::seconds(60));
+        if (!_is_body_received || !_is_ordered) {
+            std::cout << "  P2P LOOPBACK LOST OR ALTERED PROJECT BODIES, " << _received_bodies.load() << " of " << _body_count << " received" << std::endl;
+            return 2;
+        }
+        const rtdxc::detail::p2p_peer_info _sent_after = _client.get_host_info();
+        const rtdxc::detail::p2p_peer_info _received_after = _host.get_client_info(_client.get_id());
+        const double _compression_seconds = std::chrono::duration<double>(_sent_after.compression_time - _sent_before.compression_time).count();
+        const double _decompression_seconds = std::chrono::duration<double>(_received_after.decompression_time - _received_before.decompression_time).count();
+        std::cout << "  p2p compression (" << _body_payload.size() << " B body) ratio " << std::fixed << std::setprecision(2)
+                  << static_cast<double>(_body_bytes) / static_cast<double>(_sent_after.sent_bytes - _sent_before.sent_bytes)
+                  << ", " << std::setprecision(0) << static_cast<double>(_body_bytes) / (1024. * 1024.) / _compression_seconds << " MiB/s compressed"
+                  << ", " << static_cast<double>(_body_bytes) / (1024. * 1024.) / _decompression_seconds << " MiB/s decompressed" << std::endl;
+
+        // a burst of small host commits until the client applied them, every message it gets is one DAW reload
+        fmtdxc::project_container _host_container(_dxc_project);
+        fmtdxc::project_container _client_container(_dxc_project);
+        std::vector<std::uint64_t> _host_hashes;
+        std::vector<std::uint64_t> _client_hashes;
+        rtdxc::detail::update_commit_hashes(_host_container.get_commits(), _host_hashes);
+        rtdxc::detail::update_commit_hashes(_client_container.get_commits(), _client_hashes);
+        std::atomic<std::size_t> _client_commit_count = _client_container.get_commits().size();
+        std::atomic<std::size_t> _batch_count = 0;
+        std::atomic<bool> _is_following = true;
+        rtdxc::detail::symbol_table _host_symbols;
+        rtdxc::detail::symbol_table _client_symbols; // mirror of the host's
+        _client.on_receive([&](const std::vector<std::uint8_t>& _message) {
+            if (rtdxc::detail::apply_symbols(_message, _client_symbols)) {
+                return;
+            }
+            if (!rtdxc::detail::apply_commit_broadcast(_message, _client_container, _client_hashes, _client_symbols)) {
+                _is_following = false;
+            }
+            _batch_count++;
+            _client_commit_count.store(_client_container.get_commits().size(), std::memory_order_release);
+        });
+        for (const std::size_t _window_milliseconds : { std::size_t(0), std::size_t(20) }) {
+            const std::size_t _commit_count = 200;
+            rtdxc::detail::commit_batcher _batcher([&](const std::vector<std::uint8_t>& _batch) {
+                _host.broadcast(_batch);
+            },
+                std::chrono::milliseconds(_window_milliseconds));
+            _batch_count = 0;
+            const std::size_t _target_count = _host_container.get_commits().size() + _commit_count;
+            const auto _start = std::chrono::steady_clock::now();
+            for (std::size_t _index = 0; _index < _commit_count; _index++) {
+                fmtdxc::project _proj = _host_container.get_project();
+                _proj.name = "commit " + std::to_string(_index);
+                const rtdxc::detail::commit_patch _patch = rtdxc::detail::make_commit_patch(_proj.name, _proj, {}, _host_symbols);
+                rtdxc::detail::apply_commit_patch(_patch, _host_symbols, _host_container);
+                rtdxc::detail::update_commit_hashes(_host_container.get_commits(), _host_hashes);
+                _batcher.push(_patch, _host_hashes, _host_container.get_applied_count(), _host_symbols);
+            }
+            _batcher.flush();
+            const bool _is_applied = wait_until([&]() { return _client_commit_count.load(std::memory_order_acquire) == _target_count; }, std::chrono::seconds(60));
+            const double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+            if (!_is_applied || !_is_following) {
+                std::cout << "  P2P COMMIT BROADCAST LOST OR MISAPPLIED COMMITS, " << _client_commit_count.load() << " of " << _target_count << " applied" << std::endl;
+                return 2;
+            }
+            std::cout << "  p2p commit broadcast (" << _window_milliseconds << " ms window) " << _commit_count << " commits in "
+                      << _batch_count.load() << " messages, " << std::fixed << std::setprecision(1) << _seconds * 1000. << " ms" << std::endl;
+        }
+    }
+
+    // thread scaling, every thread count must give the serial bytes
+    const std::string _serial_dxc = serialize_project(rtdxc::detail::convert_from_als(_als_project));
+    const std::string _serial_als = serialize_project(rtdxc::detail::convert_to_als(_dxc_project));
+    std::vector<std::size_t> _thread_counts = { 1, 2, 4, 8 };
+    if (std::thread::hardware_concurrency() > 8) {
+        _thread_counts.push_back(std::thread::hardware_concurrency());
+    }
+    for (const std::size_t _thread_count : _thread_counts) {
+        rtdxc::detail::worker_pool _pool(_thread_count); // started outside the timed runs, like the session's
+        const rtdxc::detail::conversion_options _conversion_options { _thread_count, nullptr, &_pool };
+        fmtdxc::project _from_als;
+        print_result("convert_from_als x" + std::to_string(_thread_count), run_benchmark(_repeat_count, [&]() {
+            _from_als = rtdxc::detail::convert_from_als(_als_project, _conversion_options);
+        }));
+        fmtals::project _to_als;
+        print_result("convert_to_als x" + std::to_string(_thread_count), run_benchmark(_repeat_count, [&]() {
+            _to_als = rtdxc::detail::convert_to_als(_dxc_project, _conversion_options);
+        }));
+        if (serialize_project(_from_als) != _serial_dxc || serialize_project(_to_als) != _serial_als) {
+            std::cout << "  OUTPUT DIFFERS FROM SERIAL at " << _thread_count << " threads" << std::endl;
+            return 2;
+        }
+    }
+
+    std::cout << "peak rss " << get_peak_rss_bytes() / (1024 * 1024) << " MiB" << std::endl;
+}
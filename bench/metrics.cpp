@@ -0,0 +1,203 @@
+#include "metrics.hpp"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#include <sys/resource.h>
+#else
+#include <malloc.h>
+#include <sys/resource.h>
+#endif
+
+namespace {
+
+std::atomic<std::size_t> allocation_count { 0 };
+std::atomic<std::size_t> allocation_bytes { 0 };
+std::atomic<std::size_t> live_bytes { 0 };
+
+[[nodiscard]] std::size_t get_usable_size(void* pointer)
+{
+#if defined(_WIN32)
+    return _msize(pointer);
+#elif defined(__APPLE__)
+    return malloc_size(pointer);
+#else
+    return malloc_usable_size(pointer);
+#endif
+}
+
+[[nodiscard]] std::size_t get_usable_size(void* pointer, const std::align_val_t alignment)
+{
+#if defined(_WIN32)
+    return _aligned_msize(pointer, static_cast<std::size_t>(alignment), 0);
+#else
+    (void)alignment;
+    return get_usable_size(pointer);
+#endif
+}
+
+[[nodiscard]] void* counted_allocate(const std::size_t size)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    if (void* _pointer = std::malloc(size ? size : 1)) {
+        live_bytes.fetch_add(get_usable_size(_pointer), std::memory_order_relaxed);
+        return _pointer;
+    }
+    throw std::bad_alloc();
+}
+
+[[nodiscard]] void* counted_allocate(const std::size_t size, const std::align_val_t alignment)
+{
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+    const std::size_t _alignment = static_cast<std::size_t>(alignment);
+#if defined(_WIN32)
+    void* _pointer = _aligned_malloc(size ? size : 1, _alignment);
+#else
+    const std::size_t _rounded_size = size ? (size + _alignment - 1) / _alignment * _alignment : _alignment; // aligned_alloc wants a multiple of the alignment
+    void* _pointer = std::aligned_alloc(_alignment, _rounded_size);
+#endif
+    if (_pointer) {
+        live_bytes.fetch_add(get_usable_size(_pointer, alignment), std::memory_order_relaxed);
+        return _pointer;
+    }
+    throw std::bad_alloc();
+}
+
+void counted_free(void* pointer)
+{
+    if (pointer) {
+        live_bytes.fetch_sub(get_usable_size(pointer), std::memory_order_relaxed);
+    }
+    std::free(pointer);
+}
+
+void counted_free(void* pointer, const std::align_val_t alignment)
+{
+    if (pointer) {
+        live_bytes.fetch_sub(get_usable_size(pointer, alignment), std::memory_order_relaxed);
+    }
+#if defined(_WIN32)
+    _aligned_free(pointer);
+#else
+    std::free(pointer);
+#endif
+}
+
+}
+
+void* operator new(std::size_t size)
+{
+    return counted_allocate(size);
+}
+
+void* operator new[](std::size_t size)
+{
+    return counted_allocate(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return counted_allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return counted_allocate(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* pointer) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    counted_free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    counted_free(pointer);
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    return counted_allocate(size, alignment);
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return counted_allocate(size, alignment);
+}
+
+void operator delete(void* pointer, std::align_val_t alignment) noexcept
+{
+    counted_free(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::align_val_t alignment) noexcept
+{
+    counted_free(pointer, alignment);
+}
+
+void operator delete(void* pointer, std::size_t, std::align_val_t alignment) noexcept
+{
+    counted_free(pointer, alignment);
+}
+
+void operator delete[](void* pointer, std::size_t, std::align_val_t alignment) noexcept
+{
+    counted_free(pointer, alignment);
+}
+
+allocation_counters get_allocation_counters()
+{
+    return allocation_counters {
+        allocation_count.load(std::memory_order_relaxed),
+        allocation_bytes.load(std::memory_order_relaxed),
+        live_bytes.load(std::memory_order_relaxed)
+    };
+}
+
+std::size_t get_peak_rss_bytes()
+{
+#if defined(_WIN32)
+    PROCESS_MEMORY_COUNTERS _counters {};
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &_counters, sizeof(_counters))) {
+        return 0;
+    }
+    return static_cast<std::size_t>(_counters.PeakWorkingSetSize);
+#else
+    struct rusage _usage {};
+    if (getrusage(RUSAGE_SELF, &_usage) != 0) {
+        return 0;
+    }
+#if defined(__APPLE__)
+    return static_cast<std::size_t>(_usage.ru_maxrss); // bytes on macos
+#else
+    return static_cast<std::size_t>(_usage.ru_maxrss) * 1024; // kilobytes on linux
+#endif
+#endif
+}
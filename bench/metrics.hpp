@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstddef>
+
+struct allocation_counters {
+    std::size_t count = 0;
+    std::size_t bytes = 0;
+    std::size_t live_bytes = 0; // usable size of the blocks not deleted yet, the allocator may round requests up
+};
+
+/// @brief totals of the global operator new calls since the process started, counted from every thread
+[[nodiscard]] allocation_counters get_allocation_counters();
+
+/// @brief peak resident set size of the process in bytes, 0 when the platform doesn't report it
+[[nodiscard]] std::size_t get_peak_rss_bytes();
@@ -4,22 +4,367 @@
 #include <fmtdxc/fmtdxc.hpp>
 #include <natp2p/natp2p.hpp>
 
+#include <chrono>
 #include <functional>
+#include <future>
+#include <istream>
 #include <memory>
+#include <memory_resource>
+#include <optional>
+#include <ostream>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace rtdxc {
 
 namespace detail {
 
+    /// @brief keeps fmtdxc ids keyed on ALS track and clip ids so that re-conversions reuse them
+    struct als_identity_map {
+        std::uint32_t master_track_id = 0;
+        std::unordered_map<std::uint32_t, std::uint32_t> mixer_tracks; // ALS track id -> mixer track id
+        std::unordered_map<std::uint32_t, std::uint32_t> audio_sequencers; // ALS track id -> audio sequencer id
+        std::unordered_map<std::uint32_t, std::uint32_t> midi_sequencers; // ALS track id -> midi sequencer id
+        std::unordered_map<std::uint64_t, std::uint32_t> audio_clips; // (ALS track id, ALS clip id) -> audio clip id
+        std::uint32_t next_mixer_track_id = 1;
+        std::uint32_t next_audio_sequencer_id = 1;
+        std::uint32_t next_midi_sequencer_id = 1;
+        std::uint32_t next_audio_clip_id = 1;
+        std::uint32_t next_als_track_id = 1;
+        std::uint32_t next_als_clip_id = 1;
+    };
+
+    /// @brief ids of the fmtdxc entities that were written or erased
+    struct entity_changes {
+        std::unordered_set<std::uint32_t> mixer_tracks;
+        std::unordered_set<std::uint32_t> audio_sequencers;
+        std::unordered_set<std::uint32_t> midi_sequencers;
+    };
+
+    /// @brief remembers the content hash of each ALS track when it was last converted
+    struct als_conversion_cache {
+        std::unordered_map<std::uint32_t, std::uint64_t> track_hashes; // ALS track id -> hash of the fields convert_from_als reads
+        entity_changes changes; // entities the last call wrote or erased, everything else is untouched
+    };
+
+    /// @brief structural hash of every entity of a project, with a root per map and one for the whole project.
+    /// roots combine their entities independently of order so that an update costs the entities it touches
+    struct project_hashes {
+        std::uint64_t root = 0;
+        std::uint64_t header = 0; // name, ppq and master track id
+        std::uint64_t mixer_tracks_root = 0;
+        std::uint64_t audio_sequencers_root = 0;
+        std::uint64_t midi_sequencers_root = 0;
+        std::unordered_map<std::uint32_t, std::uint64_t> mixer_tracks;
+        std::unordered_map<std::uint32_t, std::uint64_t> audio_sequencers;
+        std::unordered_map<std::uint32_t, std::uint64_t> midi_sequencers;
+    };
+
+    /// @brief
+    struct conversion_options {
+        std::size_t thread_count = 1; // tracks are converted on this many threads, 0 uses every hardware thread
+        std::pmr::memory_resource* memory_resource = nullptr; // scratch containers of the conversion, nullptr uses the default resource
+        struct worker_pool* pool = nullptr; // runs the conversion instead of thread_count threads started for the call
+    };
+
     /// @brief
     /// @param daw_project
+    /// @param options
     /// @return
-    [[nodiscard]] fmtdxc::project convert_from_als(const fmtals::project& daw_project);
+    [[nodiscard]] fmtdxc::project convert_from_als(const fmtals::project& daw_project, const conversion_options& options = {});
 
-    /// @brief
+    /// @brief converts reusing the fmtdxc ids already assigned to the ALS tracks and clips
+    /// @param daw_project
+    /// @param identities updated with the ids of new tracks and clips, pruned from removed ones
+    /// @param options
+    /// @return
+    [[nodiscard]] fmtdxc::project convert_from_als(const fmtals::project& daw_project, als_identity_map& identities, const conversion_options& options = {});
+
+    /// @brief converts in place, only the tracks whose content hash changed since the last call are converted again
     /// @param daw_project
+    /// @param identities
+    /// @param cache
+    /// @param proj result of the previous call with the same cache, or empty
+    /// @param options
+    void convert_from_als(const fmtals::project& daw_project, als_identity_map& identities, als_conversion_cache& cache, fmtdxc::project& proj, const conversion_options& options = {});
+
+    /// @brief consuming overloads that move names out of daw_project and release each track once converted,
+    /// so that the ALS and fmtdxc trees are never both held in full
+    [[nodiscard]] fmtdxc::project convert_from_als(fmtals::project&& daw_project, const conversion_options& options = {});
+    [[nodiscard]] fmtdxc::project convert_from_als(fmtals::project&& daw_project, als_identity_map& identities, const conversion_options& options = {});
+    void convert_from_als(fmtals::project&& daw_project, als_identity_map& identities, als_conversion_cache& cache, fmtdxc::project& proj, const conversion_options& options = {});
+
+    /// @brief
+    /// @param proj
+    /// @param options
+    /// @return
+    [[nodiscard]] fmtals::project convert_to_als(const fmtdxc::project& proj, const conversion_options& options = {});
+
+    /// @brief converts giving ALS tracks and clips the ids they were imported with
+    /// @param proj
+    /// @param identities seeded with the fmtdxc ids of proj so that the next convert_from_als maps back onto them
+    /// @param options
     /// @return
-    [[nodiscard]] fmtals::project convert_to_als(const fmtdxc::project& proj);
+    [[nodiscard]] fmtals::project convert_to_als(const fmtdxc::project& proj, als_identity_map& identities, const conversion_options& options = {});
+
+    /// @brief hashes every entity of the project
+    /// @param proj
+    /// @param hashes
+    void hash_project(const fmtdxc::project& proj, project_hashes& hashes);
+
+    /// @brief rehashes the header and only the changed entities, the others keep their hash
+    /// @param proj
+    /// @param changes
+    /// @param hashes result of hash_project for proj before the changes
+    void rehash_project(const fmtdxc::project& proj, const entity_changes& changes, project_hashes& hashes);
+
+    /// @brief the candidates whose hash differs between both sides, missing on one side counts as different.
+    /// maps whose roots match are skipped whole
+    /// @param from_hashes
+    /// @param to_hashes
+    /// @param candidates entities that may differ, every other one must be equal on both sides
+    [[nodiscard]] entity_changes get_changed_entities(const project_hashes& from_hashes, const project_hashes& to_hashes, const entity_changes& candidates);
+
+    /// @brief the entities whose hash differs between both sides, every entity of either side is a candidate
+    /// @param from_hashes
+    /// @param to_hashes
+    [[nodiscard]] entity_changes get_changed_entities(const project_hashes& from_hashes, const project_hashes& to_hashes);
+
+    /// @brief same result as fmtdxc::diff, but entities whose hashes match on both sides never reach it.
+    /// maps whose roots match are skipped whole, otherwise only the candidates are compared
+    /// @param from
+    /// @param from_hashes
+    /// @param to
+    /// @param to_hashes
+    /// @param candidates entities that may differ, every other one must be equal on both sides
+    /// @param result
+    void diff(const fmtdxc::project& from, const project_hashes& from_hashes, const fmtdxc::project& to, const project_hashes& to_hashes, const entity_changes& candidates, fmtdxc::sparse_project& result);
+
+    /// @brief hashes the commits that have none yet, chained so that hashes[i] only matches on a peer holding the same first i commits.
+    /// hashes[0] stands for no commit at all, hashes past a commit that was undone then replaced must be dropped first
+    /// @param commits
+    /// @param hashes
+    void update_commit_hashes(const std::vector<fmtdxc::project_commit>& commits, std::vector<std::uint64_t>& hashes);
+
+    /// @brief rewrites only the ALS tracks and clips whose fmtdxc entities differ between from and to,
+    /// every ALS field the conversion doesn't model is kept as the DAW saved it
+    /// @param daw_project document that converts to from, patched so that it converts to to
+    /// @param from
+    /// @param to
+    /// @param identities
+    /// @param options
+    void patch_als(fmtals::project& daw_project, const fmtdxc::project& from, const fmtdxc::project& to, als_identity_map& identities, const conversion_options& options = {});
+
+    /// @brief patches as above and drops the conversion cache entry of every track it writes or removes so that the next
+    /// conversion reads them again instead of matching the hashes they had before the patch
+    void patch_als(fmtals::project& daw_project, const fmtdxc::project& from, const fmtdxc::project& to, als_identity_map& identities, als_conversion_cache& cache, const conversion_options& options = {});
+
+    /// @brief monotonic arena handed to the converters through conversion_options, released between watcher events.
+    /// its buffer grows to the largest event seen so that steady state events never reach the upstream allocator
+    struct scratch_arena {
+        scratch_arena() = delete;
+        scratch_arena(const std::size_t initial_size);
+        scratch_arena(const scratch_arena& other) = delete;
+        scratch_arena& operator=(const scratch_arena& other) = delete;
+        scratch_arena(scratch_arena&& other) noexcept = default;
+        scratch_arena& operator=(scratch_arena&& other) noexcept = default;
+
+        [[nodiscard]] std::pmr::memory_resource* get_resource() const;
+        [[nodiscard]] std::size_t get_capacity() const;
+        void reset();
+
+    private:
+        std::shared_ptr<struct scratch_arena_impl> _impl;
+    };
+
+    /// @brief id of an interned string, 0 is always the empty string
+    using symbol = std::uint32_t;
+
+    /// @brief interned names shared by a history, the commit patches it hands out and their wire encoding, safe to use
+    /// from several threads. symbols are handed out in order so that a peer can mirror the table from the symbols added
+    /// since its last sync, a table gets a random id so that a mirror notices when it follows another one
+    struct symbol_table {
+        symbol_table();
+        symbol_table(const symbol_table& other) = delete;
+        symbol_table& operator=(const symbol_table& other) = delete;
+        symbol_table(symbol_table&& other) noexcept = default;
+        symbol_table& operator=(symbol_table&& other) noexcept = default;
+
+        symbol intern(const std::string_view text);
+        [[nodiscard]] std::optional<symbol> find(const std::string_view text) const;
+        [[nodiscard]] const std::string& get_text(const symbol id) const;
+        [[nodiscard]] std::uint64_t get_id() const;
+        [[nodiscard]] std::size_t get_count() const;
+        [[nodiscard]] std::size_t get_text_bytes() const;
+        [[nodiscard]] std::vector<std::string> export_symbols(const std::size_t first) const;
+        void import_symbols(const std::size_t first, const std::vector<std::string>& texts);
+        void reset(const std::uint64_t id); // forgets every symbol but the empty one, for mirrors that follow another table from now on
+
+    private:
+        std::shared_ptr<struct symbol_table_impl> _impl;
+    };
+
+    /// @brief an entity with its names moved to symbols. names are visited in declaration order, an audio sequencer's
+    /// own name comes first then the names of its clips in id order
+    template <typename entity_t>
+    struct interned {
+        entity_t fields; // names left empty
+        std::vector<symbol> names;
+
+        template <typename archive_t>
+        void serialize(archive_t& archive)
+        {
+            archive(fields);
+            archive(names);
+        }
+    };
+
+    /// @brief moves the names of a mixer track, audio sequencer, audio clip or midi sequencer to symbols of the table
+    /// @param entity
+    /// @param symbols
+    template <typename entity_t>
+    [[nodiscard]] interned<entity_t> intern_names(const entity_t& entity, symbol_table& symbols);
+
+    /// @brief the entity intern_names was given back, throws when a symbol is not in the table
+    /// @param entity
+    /// @param symbols
+    template <typename entity_t>
+    [[nodiscard]] entity_t resolve_names(const interned<entity_t>& entity, const symbol_table& symbols);
+
+    /// @brief entities a commit wrote, with their new value or empty when it erased them
+    template <typename entity_t>
+    using entity_writes = std::vector<std::pair<std::uint32_t, std::optional<entity_t>>>;
+
+    /// @brief only what a commit wrote, committing it over the state it was made on gives the committed project.
+    /// journals and joining peers carry commits in this form instead of whole projects, with names as symbols of the
+    /// table the patch was made with so that a receiver mirrors that table first
+    struct commit_patch {
+        std::string message;
+        symbol name = 0;
+        decltype(fmtdxc::project::ppq) ppq {};
+        decltype(fmtdxc::project::master_track_id) master_track_id {};
+        entity_writes<interned<fmtdxc::project::mixer_track>> mixer_tracks;
+        entity_writes<interned<fmtdxc::project::audio_sequencer>> audio_sequencers;
+        entity_writes<interned<fmtdxc::project::midi_sequencer>> midi_sequencers;
+
+        template <typename archive_t>
+        void serialize(archive_t& archive)
+        {
+            archive(message);
+            archive(name);
+            archive(ppq);
+            archive(master_track_id);
+            archive(mixer_tracks);
+            archive(audio_sequencers);
+            archive(midi_sequencers);
+        }
+    };
+
+    /// @brief the patch of a commit, from the entities it changed
+    /// @param message
+    /// @param proj the committed project
+    /// @param changes entities that differ between proj and the state it was committed over
+    /// @param symbols the names are interned into it
+    [[nodiscard]] commit_patch make_commit_patch(const std::string& message, const fmtdxc::project& proj, const entity_changes& changes, symbol_table& symbols);
+
+    /// @brief commits the patch over the applied state of the container
+    /// @param patch
+    /// @param symbols the table the patch was made with, or a mirror of it
+    /// @param container
+    void apply_commit_patch(const commit_patch& patch, const symbol_table& symbols, fmtdxc::project_container& container);
+
+    /// @brief project states of a commit history, a checkpoint every checkpoint_interval states and the entities
+    /// each commit wrote in between, so that rebuilding any state replays less than checkpoint_interval commits.
+    /// states share every track, sequencer and clip a commit did not write, a checkpoint only costs its map nodes, and
+    /// names are kept once in the symbol table of the history.
+    /// indices are applied counts, the history covers a contiguous range of them.
+    /// the states last handed out stay cached so that handing them out again builds nothing
+    struct project_history {
+        project_history() = delete;
+        project_history(const fmtdxc::project& proj, const std::size_t index, const std::size_t checkpoint_interval, const std::size_t cache_capacity = 8);
+        project_history(const project_history& other) = delete;
+        project_history& operator=(const project_history& other) = delete;
+        project_history(project_history&& other) noexcept = default;
+        project_history& operator=(project_history&& other) noexcept = default;
+
+        [[nodiscard]] std::size_t get_first_index() const;
+        [[nodiscard]] std::size_t get_last_index() const;
+        [[nodiscard]] bool contains(const std::size_t index) const;
+        [[nodiscard]] std::size_t get_checkpoint_interval() const;
+        [[nodiscard]] std::size_t get_checkpoint_count() const;
+        [[nodiscard]] std::size_t get_cached_count() const;
+        [[nodiscard]] std::shared_ptr<const fmtdxc::project> get_project(const std::size_t index) const;
+        [[nodiscard]] std::chrono::system_clock::time_point get_commit_time(const std::size_t index) const;
+        [[nodiscard]] commit_patch get_commit_patch(const std::size_t index, const std::string& message) const; // of the commit that led to index, builds no state
+        [[nodiscard]] const symbol_table& get_symbols() const; // of the commit patches, to mirror on the peers they are sent to
+
+        /// @brief records proj as the state at index, every state after index - 1 is forgotten
+        /// @param index
+        /// @param proj
+        /// @param changes entities that differ between proj and the state at index - 1
+        /// @param time when the commit was made, the epoch when unknown
+        void commit(const std::size_t index, const fmtdxc::project& proj, const entity_changes& changes, const std::chrono::system_clock::time_point time);
+
+        /// @brief records the state of a working project checked out of this history, adopting the nodes it wrote
+        /// @param index
+        /// @param proj
+        /// @param changes entities that differ between proj and the state at index - 1
+        /// @param time
+        void commit(const std::size_t index, const struct working_project& proj, const entity_changes& changes, const std::chrono::system_clock::time_point time);
+
+        /// @brief records proj as the state right before the first one, for histories loaded after some commits.
+        /// the time of the commit that followed it is unknown
+        /// @param proj
+        void prepend(const fmtdxc::project& proj);
+
+    private:
+        friend struct working_project;
+        std::shared_ptr<struct project_history_impl> _impl;
+    };
+
+    /// @brief state of a history that can be written to without copying it. it shares every track, sequencer and clip node
+    /// with the state it was checked out at, a write only replaces the node of the entity written and interns its names in
+    /// the symbol table of the history. a whole fmtdxc::project is only built by materialize, for what needs one
+    struct working_project {
+        working_project() = delete;
+
+        /// @brief
+        /// @param history outlived by nothing, the working project keeps what it needs of it
+        /// @param index of a state the history contains
+        working_project(const project_history& history, const std::size_t index);
+        working_project(const working_project& other) = delete;
+        working_project& operator=(const working_project& other) = delete;
+        working_project(working_project&& other) noexcept = default;
+        working_project& operator=(working_project&& other) noexcept = default;
+
+        [[nodiscard]] bool has_mixer_track(const std::uint32_t id) const;
+        [[nodiscard]] bool has_audio_sequencer(const std::uint32_t id) const;
+        [[nodiscard]] bool has_midi_sequencer(const std::uint32_t id) const;
+        void set_header(const std::string& name, const decltype(fmtdxc::project::ppq) ppq, const decltype(fmtdxc::project::master_track_id) master_track_id);
+        void write(const std::uint32_t id, const fmtdxc::project::mixer_track& mt);
+        void write(const std::uint32_t id, const fmtdxc::project::audio_sequencer& as); // clips equal to the ones it had stay shared
+        void write(const std::uint32_t id, const fmtdxc::project::midi_sequencer& ms);
+        bool erase_mixer_track(const std::uint32_t id); // false when there was none
+        bool erase_audio_sequencer(const std::uint32_t id);
+        bool erase_midi_sequencer(const std::uint32_t id);
+        void assign(const fmtdxc::project& proj, const entity_changes& changes); // the header and the changed entities of proj
+        [[nodiscard]] fmtdxc::project materialize() const;
+        [[nodiscard]] fmtdxc::project materialize(const entity_changes& changes) const; // the header and the entities of changes only
+
+    private:
+        friend struct project_history;
+        std::shared_ptr<struct working_project_impl> _impl;
+    };
+
+    /// @brief converts into a working project, only the tracks whose content hash changed since the last call are written
+    /// @param daw_project
+    /// @param identities
+    /// @param cache
+    /// @param proj written by the previous call with the same cache, or checked out of a state converted with it
+    /// @param options
+    void convert_from_als(const fmtals::project& daw_project, als_identity_map& identities, als_conversion_cache& cache, working_project& proj, const conversion_options& options = {});
+    void convert_from_als(fmtals::project&& daw_project, als_identity_map& identities, als_conversion_cache& cache, working_project& proj, const conversion_options& options = {});
 
     /// @brief
     struct process {
@@ -72,28 +417,313 @@ namespace detail {
         std::shared_ptr<struct directory_watcher_impl> _impl;
     };
 
+    /// @brief runs posted tasks one at a time on its own thread. a task posted while another one is still waiting
+    /// replaces it, so a burst of posts costs the running task plus one
+    struct coalescing_worker {
+        coalescing_worker();
+        coalescing_worker(const coalescing_worker& other) = delete;
+        coalescing_worker& operator=(const coalescing_worker& other) = delete;
+        coalescing_worker(coalescing_worker&& other) noexcept = default;
+        coalescing_worker& operator=(coalescing_worker&& other) noexcept = default;
+
+        void post(const std::function<void()>& task);
+        [[nodiscard]] bool is_pending() const; // lets the running task skip work a newer one will redo
+        [[nodiscard]] std::size_t get_coalesced_count() const;
+
+    private:
+        std::shared_ptr<struct coalescing_worker_impl> _impl;
+    };
+
+    /// @brief threads started once and handed the indices of a parallel loop, the calling thread works on the loop too.
+    /// one loop runs at a time, a loop started from another thread waits for the running one to finish
+    struct worker_pool {
+        worker_pool() = delete;
+        worker_pool(const worker_pool& other) = delete;
+        worker_pool& operator=(const worker_pool& other) = delete;
+        worker_pool(worker_pool&& other) noexcept = default;
+        worker_pool& operator=(worker_pool&& other) noexcept = default;
+
+        /// @brief starts thread_count - 1 threads, fewer when the system refuses to start more
+        /// @param thread_count threads working on a loop counting the caller, 0 uses every hardware thread
+        worker_pool(const std::size_t thread_count);
+
+        /// @brief runs task(0..count-1) and returns once every index ran, the first exception a task threw is rethrown
+        /// @param count
+        /// @param task
+        void run(const std::size_t count, const std::function<void(std::size_t)>& task);
+        [[nodiscard]] std::size_t get_thread_count() const;
+
+    private:
+        std::shared_ptr<struct worker_pool_impl> _impl;
+    };
+
+    /// @brief append-only log of the commits, undos and redos made on a dxcc container since it was last written whole.
+    /// records are written as they come and a writer thread syncs them to disk once per sync window, a torn last
+    /// record is dropped when the journal is replayed. the journal lives next to the container with a .journal suffix
+    struct container_journal {
+        container_journal() = delete;
+
+        /// @brief imports the container and replays its journal into container, then appends to that journal
+        /// @param container_path
+        /// @param container
+        /// @param sync_window how long a record may wait for others to share its sync
+        container_journal(const std::filesystem::path& container_path, fmtdxc::project_container& container, const std::chrono::milliseconds sync_window);
+        container_journal(const container_journal& other) = delete;
+        container_journal& operator=(const container_journal& other) = delete;
+        container_journal(container_journal&& other) noexcept = default;
+        container_journal& operator=(container_journal&& other) noexcept = default;
+
+        /// @brief records a commit of proj over the applied state of the container
+        /// @param message
+        /// @param proj
+        /// @param changes entities that differ between proj and the state it was committed over
+        void append_commit(const std::string& message, const fmtdxc::project& proj, const entity_changes& changes);
+        void append_undo();
+        void append_redo();
+
+        /// @brief replaces the container file with container and starts an empty journal, once the records queued before are written
+        /// @param container
+        void rewrite(const fmtdxc::project_container& container);
+
+        /// @brief blocks until every record appended so far is on disk, rethrows what the writer thread failed on
+        void flush();
+
+        [[nodiscard]] std::uintmax_t get_container_bytes() const;
+        [[nodiscard]] std::uintmax_t get_journal_bytes() const; // appended since the container was last written whole
+        [[nodiscard]] std::size_t get_sync_count() const;
+
+    private:
+        std::shared_ptr<struct container_journal_impl> _impl;
+    };
+
+    /// @brief
+    struct autosave_metrics {
+        std::size_t requested_count = 0; // changes notified
+        std::size_t coalesced_count = 0; // notifications folded into a save that was already waiting
+        std::size_t saved_count = 0; // saves written, each one covers every change notified before it started
+        std::size_t skipped_count = 0; // saves that exported the bytes already on disk
+        std::size_t failed_count = 0;
+        std::chrono::steady_clock::duration last_lag {}; // from the oldest change the last save covered to that save being on disk
+        std::chrono::steady_clock::duration max_lag {};
+        std::chrono::steady_clock::duration pending_lag {}; // age of the oldest change not on disk yet
+        std::chrono::steady_clock::duration last_save_duration {}; // export and write of the last save
+        std::uintmax_t last_bytes = 0; // of the last container written
+        bool is_dirty = false; // some change is not on disk yet
+    };
+
+    /// @brief writes a container whole on its own thread after it changes, changes notified while a save runs are
+    /// coalesced into the next one. the new file replaces the old one with a rename so that it is never seen half written,
+    /// and the changes left when it is destroyed are saved before it returns
+    struct container_autosave {
+        container_autosave() = delete;
+
+        /// @brief
+        /// @param container_path
+        /// @param export_callback writes the container as it is now, called from the save thread
+        container_autosave(const std::filesystem::path& container_path, const std::function<void(std::ostream&)>& export_callback);
+        container_autosave(const container_autosave& other) = delete;
+        container_autosave& operator=(const container_autosave& other) = delete;
+        container_autosave(container_autosave&& other) noexcept = default;
+        container_autosave& operator=(container_autosave&& other) noexcept = default;
+
+        void notify(); // returns right away, the save runs later
+        [[nodiscard]] autosave_metrics get_metrics() const;
+
+    private:
+        std::shared_ptr<struct container_autosave_impl> _impl;
+    };
+
+    /// @brief imports a dxcc container and replays the journal next to it, if any, without touching either file
+    /// @param container_path
+    /// @param container
+    void load_container(const std::filesystem::path& container_path, fmtdxc::project_container& container);
+
+    /// @brief join message of a client, naming the commits and symbols it already holds so that the host only sends the ones after them
+    /// @param commit_hashes as the host sent them, empty for a client that holds nothing yet
+    /// @param symbols the client's mirror of the host's symbol table
+    [[nodiscard]] std::vector<std::uint8_t> encode_join(const std::vector<std::uint64_t>& commit_hashes, const symbol_table& symbols);
+
+    /// @brief the host's answer to a join, the symbols then the commits the client misses along with the applied count. the whole
+    /// container is only sent when the client holds nothing, holds a commit the host doesn't, or stopped before the states the history covers
+    /// @param join
+    /// @param container
+    /// @param history of the container, covering its last commit
+    /// @param commit_hashes of the container, from update_commit_hashes
+    [[nodiscard]] std::vector<std::uint8_t> encode_join_reply(const std::vector<std::uint8_t>& join, const fmtdxc::project_container& container, const project_history& history, const std::vector<std::uint64_t>& commit_hashes);
+
+    /// @brief brings the container that sent the join to the host's commits and applied count
+    /// @param reply
+    /// @param container
+    /// @param commit_hashes replaced with the host's, to send with the next join
+    /// @param symbols mirror of the host's symbol table, brought up to date first
+    /// @return whether the host sent the whole container
+    bool apply_join_reply(const std::vector<std::uint8_t>& reply, fmtdxc::project_container& container, std::vector<std::uint64_t>& commit_hashes, symbol_table& symbols);
+
+    /// @brief writes the reply encode_join_reply returns, so that a chunk_sender can stream it without ever holding it whole
+    /// @param stream
+    /// @param join
+    /// @param container
+    /// @param history
+    /// @param commit_hashes
+    void write_join_reply(std::ostream& stream, const std::vector<std::uint8_t>& join, const fmtdxc::project_container& container, const project_history& history, const std::vector<std::uint64_t>& commit_hashes);
+
+    /// @brief reads a reply like apply_join_reply, from a chunk_receiver stream as the chunks arrive
+    /// @param reply
+    /// @param container
+    /// @param commit_hashes
+    /// @param symbols
+    /// @return whether the host sent the whole container
+    bool apply_join_reply(std::istream& reply, fmtdxc::project_container& container, std::vector<std::uint64_t>& commit_hashes, symbol_table& symbols);
+
+    /// @brief batches the commits the host broadcasts, so that a burst of them goes out as one commit_broadcast message once
+    /// the window passed since the first. batches are broadcast in order from a thread of the batcher, each right after a
+    /// symbols message when its commits interned new names, and the ones still pending when it is destroyed are dropped
+    struct commit_batcher {
+        commit_batcher() = delete;
+
+        /// @brief
+        /// @param broadcast_callback sends a batch to every client
+        /// @param window how long the first commit of a batch waits for the ones after it, zero broadcasts them one by one
+        /// @param max_commit_count commits after which a batch leaves without waiting for the window
+        commit_batcher(const std::function<void(const std::vector<std::uint8_t>&)>& broadcast_callback, const std::chrono::milliseconds window = std::chrono::milliseconds(20), const std::size_t max_commit_count = 256);
+        commit_batcher(const commit_batcher& other) = delete;
+        commit_batcher& operator=(const commit_batcher& other) = delete;
+        commit_batcher(commit_batcher&& other) noexcept = default;
+        commit_batcher& operator=(commit_batcher&& other) noexcept = default;
+
+        void push(const commit_patch& patch, const std::vector<std::uint64_t>& commit_hashes, const std::size_t applied_count, const symbol_table& symbols); // once the host committed and updated its hashes
+        void flush(); // broadcasts the pending batch before returning, so that an undo or redo broadcast after it stays in order
+        [[nodiscard]] std::size_t get_batched_count() const; // commits that went out along with others
+
+    private:
+        std::shared_ptr<struct commit_batcher_impl> _impl;
+    };
+
+    /// @brief mirrors the symbols the host sends ahead of the commit broadcasts that use them
+    /// @param message any message of the host
+    /// @param symbols mirror of the host's symbol table
+    /// @return false when the message is not a symbols message, it is left to the other handlers
+    bool apply_symbols(const std::vector<std::uint8_t>& message, symbol_table& symbols);
+
+    /// @brief applies a batch of the host's commits as a whole, it is decoded and checked before the container changes so
+    /// that the caller reloads the DAW project once per batch
+    /// @param message
+    /// @param container
+    /// @param commit_hashes extended with the hashes of the batch, past the commits it drops
+    /// @param symbols mirror of the host's symbol table
+    /// @return false when the container misses commits before the batch, has applied others than the host or the mirror
+    /// misses names of the batch, it must join again. commits past the applied ones are dropped like the host did
+    bool apply_commit_broadcast(const std::vector<std::uint8_t>& message, fmtdxc::project_container& container, std::vector<std::uint64_t>& commit_hashes, const symbol_table& symbols);
+
+    /// @brief how far a chunked transfer went
+    struct transfer_progress {
+        std::uint64_t transfer_id = 0;
+        std::uint64_t transferred_bytes = 0; // acknowledged by the peer on the sending side, read on the receiving side
+        std::uint64_t total_bytes = 0; // 0 until the last chunk was written
+    };
+
+    /// @brief streams what a write callback produces to one peer, in chunks that never get more than window_size bytes
+    /// ahead of what the peer has read. the callback runs once on a thread of the sender, the size of the transfer is only
+    /// known once it returned and travels with the last chunk. the chunks the peer didn't acknowledge yet are kept, resume
+    /// sends them again once the peer is back under the same id
+    struct chunk_sender {
+        chunk_sender() = delete;
+
+        /// @brief
+        /// @param send_callback sends a message to the peer, from the sender thread or the one calling resume
+        /// @param chunk_size
+        /// @param window_size at least chunk_size
+        chunk_sender(const std::function<void(const std::vector<std::uint8_t>&)>& send_callback, const std::size_t chunk_size = 64 << 10, const std::size_t window_size = 2 << 20);
+        chunk_sender(const chunk_sender& other) = delete;
+        chunk_sender& operator=(const chunk_sender& other) = delete;
+        chunk_sender(chunk_sender&& other) noexcept = default;
+        chunk_sender& operator=(chunk_sender&& other) noexcept = default;
+
+        std::uint64_t start(const std::function<void(std::ostream&)>& write_callback); // abandons the running transfer
+        void resume(); // after a rebind or a reconnect
+        bool receive(const std::vector<std::uint8_t>& message); // false when the message was not meant for the sender
+        void wait(); // until the peer read the last transfer, rethrows what its write callback threw
+        void on_progress(const std::function<void(const transfer_progress&)>& progress_callback); // as acknowledgements arrive
+
+    private:
+        std::shared_ptr<struct chunk_sender_impl> _impl;
+    };
+
+    /// @brief reads the transfers of a chunk_sender as their chunks arrive. the read callback runs on a thread of the receiver
+    /// and chunks are only acknowledged once it read them, so that the receiver holds at most the sender's window
+    struct chunk_receiver {
+        chunk_receiver() = delete;
+
+        /// @brief
+        /// @param send_callback sends acknowledgements to the sender, from the receiver thread or the one calling receive
+        /// @param read_callback
+        chunk_receiver(const std::function<void(const std::vector<std::uint8_t>&)>& send_callback, const std::function<void(std::istream&)>& read_callback);
+        chunk_receiver(const chunk_receiver& other) = delete;
+        chunk_receiver& operator=(const chunk_receiver& other) = delete;
+        chunk_receiver(chunk_receiver&& other) noexcept = default;
+        chunk_receiver& operator=(chunk_receiver&& other) noexcept = default;
+
+        bool receive(const std::vector<std::uint8_t>& message); // false when the message was not meant for the receiver
+        void wait(); // until a transfer was read, rethrows what the read callback threw
+        void on_progress(const std::function<void(const transfer_progress&)>& progress_callback); // as the read callback goes through chunks
+
+    private:
+        std::shared_ptr<struct chunk_receiver_impl> _impl;
+    };
+
+    /// @brief LZ77 block compression after LZ4, matches are found through the last position of every 4 bytes hashed.
+    /// serialized structs repeat their field layouts and names, which is what it finds
+    /// @param data
+    /// @param size
+    /// @param block the block is appended to it
+    void compress_block(const std::uint8_t* data, const std::size_t size, std::vector<std::uint8_t>& block);
+
+    /// @brief
+    /// @param block
+    /// @param block_size
+    /// @param size of the data the block was compressed from
+    /// @param data the size bytes are appended to it, what was appended is unspecified when the block throws
+    void decompress_block(const std::uint8_t* block, const std::size_t block_size, const std::size_t size, std::vector<std::uint8_t>& data);
+
     /// @brief
     struct p2p_peer_info {
         std::string remote_ip;
         std::uint16_t remote_port;
         std::chrono::steady_clock::time_point last_seen;
-        std::uint64_t received_bytes;
-        std::uint64_t sent_bytes;
+        std::uint64_t received_bytes; // as they came over the wire
+        std::uint64_t sent_bytes; // as they went over the wire
+        std::uint64_t received_payload_bytes = 0; // once decompressed
+        std::uint64_t sent_payload_bytes = 0; // before compression, over sent_bytes gives the compression ratio
+        std::chrono::steady_clock::duration compression_time {}; // of what was sent to the peer, a broadcast counts on every peer
+        std::chrono::steady_clock::duration decompression_time {};
     };
 
     /// @brief
     using p2p_client_id = std::uint32_t;
 
-    /// @brief
+    /// @brief ENet transport of a p2p host, one thread services every endpoint it listens on while callbacks run one
+    /// at a time on a dispatch thread of their own. sends from any thread are queued without a lock and go out within
+    /// a millisecond, and the network thread hands what it receives to the dispatch thread without ever waiting on it.
+    /// clients keep their id when they reconnect from another address. each side announces the codecs it decodes once
+    /// connected, payloads are then compressed on the sending thread, with ENet's range coder below 1 KiB and the LZ block codec above
     struct p2p_host {
         p2p_host() = delete;
+
+        /// @brief listens on every interface at the port of the lease
+        /// @param host_endpoint
         p2p_host(const natp2p::endpoint_lease& host_endpoint);
+
+        /// @brief listens without a lease, for LAN and loopback sessions
+        /// @param ipv4 local address to listen on, 0.0.0.0 for every interface
+        /// @param port 0 lets the system pick one
+        p2p_host(const std::string& ipv4, const std::uint16_t port);
         p2p_host(const p2p_host& other) = delete;
         p2p_host& operator=(const p2p_host& other) = delete;
         p2p_host(p2p_host&& other) noexcept = default;
         p2p_host& operator=(p2p_host&& other) noexcept = default;
         // ~p2p_host() noexcept;
 
+        [[nodiscard]] std::uint16_t get_port() const; // of the endpoint it was created with
         [[nodiscard]] std::vector<p2p_client_id> get_clients() const;
         [[nodiscard]] p2p_peer_info get_client_info(const p2p_client_id id) const;
         void add_manual_ipv4_endpoint(const std::string& ipv4, const std::uint16_t port);
@@ -109,16 +739,22 @@ namespace detail {
         std::shared_ptr<struct host_session_impl> _impl;
     };
 
-    /// @brief
+    /// @brief ENet transport of a p2p client, threaded like p2p_host. connecting blocks until the host accepts
     struct p2p_client {
         p2p_client() = delete;
         p2p_client(const natp2p::endpoint_data& host_endpoint);
+
+        /// @brief connects under the id of a client that was connected before, so that the host knows it again
+        /// @param host_endpoint
+        /// @param id
+        p2p_client(const natp2p::endpoint_data& host_endpoint, const p2p_client_id id);
         p2p_client(const p2p_client& other) = delete;
         p2p_client& operator=(const p2p_client& other) = delete;
         p2p_client(p2p_client&& other) noexcept = default;
         p2p_client& operator=(p2p_client&& other) noexcept = default;
         // ~p2p_client() noexcept;
 
+        [[nodiscard]] p2p_client_id get_id() const;
         [[nodiscard]] p2p_peer_info get_host_info() const;
         void send(const std::vector<std::uint8_t>& payload);
         void on_disconnect(const std::function<void()>& disconnect_callback);
@@ -133,6 +769,101 @@ namespace detail {
 /// @brief
 using daw_version = std::variant<fmtals::version, int>;
 
+/// @brief outcome of importing one ALS set, error is set when the set was skipped
+struct import_result {
+    std::filesystem::path als_path;
+    std::filesystem::path dxcc_path;
+    std::uintmax_t als_bytes = 0;
+    std::optional<std::string> error;
+};
+
+/// @brief
+struct import_options {
+    std::size_t job_count = 0; // sets imported at once, 0 uses every hardware thread
+    std::uintmax_t max_bytes_in_flight = 256ULL << 20; // estimated memory of running jobs, a larger set still runs alone. each set counts three times its decompressed XML, for the XML, the ALS tree and the converted project
+    std::function<void(const import_result&)> progress_callback; // called from the jobs as each set completes
+};
+
+/// @brief every ALS set below the directory, sorted, without the copies ableton keeps in Backup folders
+/// @param directory_path
+[[nodiscard]] std::vector<std::filesystem::path> find_als_sets(const std::filesystem::path& directory_path);
+
+/// @brief imports, converts and exports ALS sets as new dxcc containers of the collection directory.
+/// containers are named after their set and never overwrite an existing file
+/// @param als_paths
+/// @param collection_directory_path
+/// @param options
+/// @return one result per path, in the same order
+[[nodiscard]] std::vector<import_result> import_many(
+    const std::vector<std::filesystem::path>& als_paths,
+    const std::filesystem::path& collection_directory_path,
+    const import_options& options = {});
+
+/// @brief steps of opening a local session, the DAW launches on its own thread while the ones before daw_load run
+enum struct session_stage {
+    container_import,
+    conversion,
+    als_export,
+    history_setup,
+    daw_launch,
+    daw_load,
+    watcher_setup,
+};
+
+/// @brief
+struct session_stage_timing {
+    session_stage stage;
+    std::chrono::steady_clock::duration start; // since the session started opening
+    std::chrono::steady_clock::duration duration;
+};
+
+/// @brief percentiles of a latency, read back from buckets a sixteenth of a power of two wide
+struct latency_summary {
+    std::size_t count = 0;
+    std::chrono::steady_clock::duration p50 {};
+    std::chrono::steady_clock::duration p99 {};
+    std::chrono::steady_clock::duration max {}; // exact
+};
+
+/// @brief how long a set saved by the DAW takes to reach get_diff_from_last_commit, stage by stage.
+/// stages only count the imports that completed, so that they add up to the total
+struct save_latency_metrics {
+    latency_summary watcher_notification; // from the set being written to its import starting, with the wait behind a running import
+    latency_summary file_read;
+    latency_summary als_decode;
+    latency_summary conversion; // with the wait for the session lock and rehashing the converted entities
+    latency_summary diff;
+    latency_summary total; // from the set being written to the diff reflecting it
+    std::size_t notified_count = 0; // watcher events
+    std::size_t coalesced_count = 0; // events replaced by a newer one before their import started
+    std::size_t dropped_count = 0; // imports abandoned once decoded because a newer event was waiting
+    std::size_t failed_count = 0;
+    std::uintmax_t read_bytes = 0; // of every set read
+};
+
+/// @brief writes the metrics as one JSON object, durations in microseconds
+/// @param stream
+/// @param metrics
+void export_save_latency_metrics(std::ostream& stream, const save_latency_metrics& metrics);
+
+/// @brief
+struct session_options {
+    std::size_t checkpoint_interval = 32; // commits between history checkpoints, undo and redo replay fewer commits than this and every checkpoint shares unchanged entities with the others
+    std::size_t checkout_cache_capacity = 8; // states project_at keeps built, least recently used first out
+    bool is_journaled = false; // commits, undos and redos append to a journal next to the opened container instead of leaving it as it was
+    std::chrono::milliseconds journal_sync_window { 50 }; // records appended within it share one sync
+    double journal_compaction_ratio = 1.; // the container is written whole once its journal outgrows it this many times
+    bool is_autosaved = false; // the opened container is written whole on a background thread after each change, not along with is_journaled
+    std::function<void(const session_stage_timing&)> stage_callback; // called as each stage completes, never for two stages at once
+};
+
+/// @brief commits a compaction keeps as they are, the ones in between are squashed into the next kept commit.
+/// the last and the applied commits are always kept
+struct retention_policy {
+    std::size_t keep_last = 256; // most recent commits
+    bool keep_daily_anchors = true; // last commit of each UTC day, commits of unknown time only count for keep_last
+};
+
 /// @brief launches process on it and on modification updates sparse diff
 struct local_session {
     local_session() = delete;
@@ -140,30 +871,74 @@ struct local_session {
         const daw_version version,
         const std::filesystem::path& daw_path,
         const std::optional<std::filesystem::path>& container_path,
-        const std::function<std::optional<std::filesystem::path>()>& exit_callback);
+        const std::function<std::optional<std::filesystem::path>()>& exit_callback,
+        const session_options& options = {});
     local_session(const local_session& other) = delete;
     local_session& operator=(const local_session& other) = delete;
     local_session(local_session&& other) = default;
     local_session& operator=(local_session&& other) = default;
 
+    /// @brief opens the session on a thread of its own, the future holds it once the DAW shows the project
+    /// @param version
+    /// @param daw_path
+    /// @param container_path
+    /// @param exit_callback
+    /// @param options
+    [[nodiscard]] static std::future<local_session> open(
+        const daw_version version,
+        const std::filesystem::path& daw_path,
+        const std::optional<std::filesystem::path>& container_path,
+        const std::function<std::optional<std::filesystem::path>()>& exit_callback,
+        const session_options& options = {});
+
     [[nodiscard]] bool can_commit() const;
     [[nodiscard]] bool can_undo() const;
     [[nodiscard]] bool can_redo() const;
     [[nodiscard]] std::size_t get_applied_count() const;
     [[nodiscard]] const std::vector<fmtdxc::project_commit>& get_commits() const;
-    [[nodiscard]] const fmtdxc::sparse_project& get_diff_from_last_commit() const;
+    [[nodiscard]] fmtdxc::sparse_project get_diff_from_last_commit() const;
     [[nodiscard]] const std::filesystem::path& get_temp_directory_path() const;
+    [[nodiscard]] const std::vector<session_stage_timing>& get_startup_timings() const; // in the order the stages completed
+    [[nodiscard]] detail::autosave_metrics get_autosave_metrics() const; // all zero unless autosaved
+    [[nodiscard]] save_latency_metrics get_save_latency_metrics() const; // since the session opened
+
+    /// @brief read-only state of the project after commit_index commits, without undoing anything.
+    /// states before the one the container was loaded at are only reachable by undoing down to them
+    /// @param commit_index 0 for the project before the first commit, up to the number of commits
+    [[nodiscard]] std::shared_ptr<const fmtdxc::project> project_at(const std::size_t commit_index) const;
+
+    /// @brief squashes the history in the background, commit, undo and redo keep working meanwhile.
+    /// does nothing while a compaction is already running
+    /// @param policy
+    void compact(const retention_policy& policy = {});
+
+    /// @brief installs a finished compaction, from the thread that reads get_commits since it replaces them.
+    /// commits made meanwhile are carried over
+    /// @return false when none is ready, or when the history was rewritten or undone below a squashed commit meanwhile
+    bool apply_compaction();
+
+    [[nodiscard]] bool is_compacting() const;
+
     void commit(const std::string& message);
+
+    /// @brief takes the previous state from the history and only journals the undo. fmtdxc moves the applied commit of a
+    /// container by replaying commits, that replay waits until the container is committed over or written whole.
+    /// the session stays on the state it was at if the set for the DAW cannot be written
     void undo();
+
+    /// @brief takes the next state from the history and only journals the redo, like undo
     void redo();
 
 private:
+    void reload_daw_project(const std::size_t index); // the session lock held, moves to index once the set is written
+
     daw_version _daw_version;
     std::filesystem::path _temp_directory_path;
-    fmtdxc::project_container _container;
-    fmtdxc::sparse_project _next_diff; // for ui
-    fmtdxc::project _next_proj;
+    std::filesystem::path _daw_temp_project_path;
+    std::vector<session_stage_timing> _startup_timings;
+    std::shared_ptr<struct local_session_state> _state; // shared with the session worker so that moving the session is safe
     std::unique_ptr<detail::process> _daw_process;
+    std::unique_ptr<detail::coalescing_worker> _worker; // imports and diffs DAW saves off the watcher thread
     std::unique_ptr<detail::file_watcher> _daw_temp_project_watcher;
 };
 
@@ -186,7 +961,7 @@ struct p2p_host_session {
     [[nodiscard]] bool can_redo() const;
     [[nodiscard]] std::size_t get_applied_count() const;
     [[nodiscard]] const std::vector<fmtdxc::project_commit>& get_commits() const;
-    [[nodiscard]] const fmtdxc::sparse_project& get_diff_from_last_commit() const;
+    [[nodiscard]] fmtdxc::sparse_project get_diff_from_last_commit() const;
     [[nodiscard]] const std::filesystem::path& get_temp_directory_path() const;
     void commit(const std::string& message);
     void undo();
@@ -212,7 +987,7 @@ struct p2p_client_session {
 
     [[nodiscard]] std::size_t get_applied_count() const;
     [[nodiscard]] const std::vector<fmtdxc::project_commit>& get_commits() const;
-    [[nodiscard]] const fmtdxc::sparse_project& get_diff_from_last_commit() const;
+    [[nodiscard]] fmtdxc::sparse_project get_diff_from_last_commit() const;
     [[nodiscard]] const std::filesystem::path& get_temp_directory_path() const;
     void commit(const std::string& message);
 
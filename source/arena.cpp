@@ -0,0 +1,79 @@
+#include <rtdxc/rtdxc.hpp>
+
+#include <optional>
+
+namespace rtdxc {
+namespace detail {
+
+    namespace {
+
+        // Forwards to new/delete and remembers how much the arena asked for once its buffer ran out
+        struct counting_upstream : std::pmr::memory_resource {
+            std::size_t requested_bytes = 0;
+
+        private:
+            void* do_allocate(std::size_t bytes, std::size_t alignment) override
+            {
+                requested_bytes += bytes;
+                return std::pmr::new_delete_resource()->allocate(bytes, alignment);
+            }
+
+            void do_deallocate(void* pointer, std::size_t bytes, std::size_t alignment) override
+            {
+                std::pmr::new_delete_resource()->deallocate(pointer, bytes, alignment);
+            }
+
+            bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override
+            {
+                return this == &other;
+            }
+        };
+
+    }
+
+    struct scratch_arena_impl {
+        explicit scratch_arena_impl(const std::size_t initial_size)
+        {
+            rebuild(initial_size);
+        }
+
+        void rebuild(const std::size_t size)
+        {
+            arena.reset();
+            if (size != capacity) {
+                buffer = std::make_unique<std::byte[]>(size);
+                capacity = size;
+            }
+            upstream.requested_bytes = 0;
+            arena.emplace(buffer.get(), capacity, &upstream);
+        }
+
+        counting_upstream upstream;
+        std::unique_ptr<std::byte[]> buffer;
+        std::size_t capacity = 0;
+        std::optional<std::pmr::monotonic_buffer_resource> arena;
+    };
+
+    scratch_arena::scratch_arena(const std::size_t initial_size)
+        : _impl(std::make_shared<scratch_arena_impl>(initial_size ? initial_size : 1))
+    {
+    }
+
+    std::pmr::memory_resource* scratch_arena::get_resource() const
+    {
+        return &_impl->arena.value();
+    }
+
+    std::size_t scratch_arena::get_capacity() const
+    {
+        return _impl->capacity;
+    }
+
+    void scratch_arena::reset()
+    {
+        // Whatever overflowed this time is folded into the buffer so the next event of the same size fits
+        _impl->rebuild(_impl->capacity + _impl->upstream.requested_bytes);
+    }
+
+}
+}
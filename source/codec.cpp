@@ -0,0 +1,157 @@
+#include <rtdxc/rtdxc.hpp>
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <stdexcept>
+
+namespace rtdxc {
+namespace detail {
+
+    namespace {
+
+        static constexpr std::size_t min_match = 4;
+        static constexpr std::size_t max_offset = 0xffff;
+        static constexpr std::size_t hash_bits = 12;
+        static constexpr std::size_t skip_shift = 6; // literals in a row before the search steps faster over incompressible data
+
+        std::uint32_t read_u32(const std::uint8_t* data)
+        {
+            std::uint32_t value;
+            std::memcpy(&value, data, sizeof(value));
+            return value;
+        }
+
+        std::size_t hash_u32(const std::uint32_t value)
+        {
+            return (value * 2654435761u) >> (32 - hash_bits);
+        }
+
+        // Lengths past the 4 bits of the token go on in bytes of 255 until a smaller one
+        void write_length(std::size_t length, std::vector<std::uint8_t>& block)
+        {
+            while (length >= 255) {
+                block.push_back(255);
+                length -= 255;
+            }
+            block.push_back(static_cast<std::uint8_t>(length));
+        }
+
+        void write_sequence(const std::uint8_t* literals, const std::size_t literal_count, const std::size_t offset, const std::size_t match_length, std::vector<std::uint8_t>& block)
+        {
+            const std::size_t matchCode = match_length ? match_length - min_match : 0;
+            block.push_back(static_cast<std::uint8_t>((std::min<std::size_t>(literal_count, 15) << 4) | std::min<std::size_t>(matchCode, 15)));
+            if (literal_count >= 15) {
+                write_length(literal_count - 15, block);
+            }
+            block.insert(block.end(), literals, literals + literal_count);
+            if (!match_length) {
+                return; // the last sequence of a block only has literals
+            }
+            block.push_back(static_cast<std::uint8_t>(offset));
+            block.push_back(static_cast<std::uint8_t>(offset >> 8));
+            if (matchCode >= 15) {
+                write_length(matchCode - 15, block);
+            }
+        }
+
+        struct block_reader {
+            [[nodiscard]] std::uint8_t read()
+            {
+                if (position == end) {
+                    throw std::invalid_argument("Block provided to decompression ends in the middle of a sequence");
+                }
+                return *position++;
+            }
+
+            [[nodiscard]] std::size_t read_length(std::size_t length)
+            {
+                std::uint8_t byte;
+                do {
+                    byte = read();
+                    length += byte;
+                } while (byte == 255);
+                return length;
+            }
+
+            const std::uint8_t* position;
+            const std::uint8_t* end;
+        };
+
+    }
+
+    void compress_block(const std::uint8_t* data, const std::size_t size, std::vector<std::uint8_t>& block)
+    {
+        std::array<std::uint32_t, std::size_t(1) << hash_bits> positions {}; // last position + 1 of every hashed 4 bytes, 0 when none
+        std::size_t anchor = 0;
+        std::size_t position = 0;
+        while (size >= min_match && position <= size - min_match) {
+            const std::uint32_t sequence = read_u32(data + position);
+            std::uint32_t& candidate = positions[hash_u32(sequence)];
+            const std::size_t match = candidate;
+            candidate = static_cast<std::uint32_t>(position + 1);
+            if (!match || position + 1 - match > max_offset || read_u32(data + match - 1) != sequence) {
+                position += 1 + ((position - anchor) >> skip_shift);
+                continue;
+            }
+            std::size_t length = min_match;
+            while (position + length < size && data[match - 1 + length] == data[position + length]) {
+                ++length;
+            }
+            write_sequence(data + anchor, position - anchor, position + 1 - match, length, block);
+            position += length;
+            anchor = position;
+        }
+        write_sequence(data + anchor, size - anchor, 0, 0, block);
+    }
+
+    void decompress_block(const std::uint8_t* block, const std::size_t block_size, const std::size_t size, std::vector<std::uint8_t>& data)
+    {
+        const std::size_t first = data.size();
+        data.resize(first + size);
+        std::uint8_t* const begin = data.data() + first;
+        std::size_t written = 0;
+        block_reader reader { block, block + block_size };
+        while (true) {
+            const std::uint8_t token = reader.read();
+            std::size_t literalCount = token >> 4;
+            if (literalCount == 15) {
+                literalCount = reader.read_length(literalCount);
+            }
+            if (literalCount > static_cast<std::size_t>(reader.end - reader.position) || written + literalCount > size) {
+                throw std::invalid_argument("Block provided to decompression has literals past its end");
+            }
+            std::memcpy(begin + written, reader.position, literalCount);
+            written += literalCount;
+            reader.position += literalCount;
+            if (reader.position == reader.end) {
+                break;
+            }
+
+            const std::size_t offsetLow = reader.read();
+            const std::size_t offset = offsetLow | (static_cast<std::size_t>(reader.read()) << 8);
+            std::size_t length = (token & 15) + min_match;
+            if ((token & 15) == 15) {
+                length = reader.read_length(length);
+            }
+            if (!offset || offset > written || written + length > size) {
+                throw std::invalid_argument("Block provided to decompression has a match outside of its data");
+            }
+            std::uint8_t* const target = begin + written;
+            if (offset >= length) {
+                std::memcpy(target, target - offset, length);
+            } else {
+                // Byte by byte since the match overlaps what it copies, which is how runs are encoded
+                for (std::size_t index = 0; index < length; ++index) {
+                    target[index] = target[index - offset];
+                }
+            }
+            written += length;
+        }
+        if (written != size) {
+            throw std::invalid_argument("Block provided to decompression is not of the size it was compressed from");
+        }
+    }
+
+}
+}
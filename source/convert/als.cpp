@@ -1,7 +1,15 @@
+#include <rtdxc/rtdxc.hpp>
+
 #include <fmtals/fmtals.hpp>
 #include <fmtdxc/fmtdxc.hpp>
 
+#include <algorithm>
 #include <limits>
+#include <map>
+#include <memory_resource>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
 #include <variant>
 
 namespace rtdxc {
@@ -9,97 +17,800 @@ namespace detail {
     namespace {
 
         /* tiny helpers */
-        static std::string pick_name(const std::string& effective, const std::string& user)
+        // Moves out of non-const sources, copies out of const ones
+        template <typename value_t>
+        static std::conditional_t<std::is_const_v<value_t>, value_t&, value_t&&> take(value_t& value)
+        {
+            return static_cast<std::conditional_t<std::is_const_v<value_t>, value_t&, value_t&&>>(value);
+        }
+
+        // User name when set, effective name otherwise
+        template <typename track_t>
+        static std::string take_name(track_t& track)
+        {
+            return track.user_name.empty() ? std::string(take(track.effective_name)) : std::string(take(track.user_name));
+        }
+
+        template <typename value_t>
+        static void release(value_t& value)
+        {
+            if constexpr (!std::is_const_v<value_t>) {
+                value_t {}.swap(value);
+            }
+        }
+
+        using als_track = std::decay_t<decltype(fmtals::project::tracks)>::value_type;
+
+        // Scratch containers live on the caller's arena, the default resource otherwise
+        static std::pmr::memory_resource* scratch_resource(const conversion_options& options)
+        {
+            return options.memory_resource ? options.memory_resource : std::pmr::get_default_resource();
+        }
+
+        /* stable ids */
+        static std::uint64_t make_clip_key(const std::uint32_t als_track_id, const std::uint32_t als_clip_id)
+        {
+            return (static_cast<std::uint64_t>(als_track_id) << 32) | als_clip_id;
+        }
+
+        template <typename key_t>
+        static std::uint32_t acquire_id(std::unordered_map<key_t, std::uint32_t>& ids, const key_t key, std::uint32_t& next_id)
+        {
+            const auto [it, inserted] = ids.try_emplace(key, next_id);
+            if (inserted) {
+                ++next_id;
+            }
+            return it->second;
+        }
+
+        template <typename key_t>
+        static void prune_ids(std::unordered_map<key_t, std::uint32_t>& ids, const std::pmr::unordered_set<key_t>& seen)
+        {
+            for (auto it = ids.begin(); it != ids.end();) {
+                it = seen.count(it->first) ? std::next(it) : ids.erase(it);
+            }
+        }
+
+        template <typename value_t>
+        static std::pmr::unordered_map<std::uint32_t, std::uint32_t> invert_ids(const std::unordered_map<value_t, std::uint32_t>& ids, std::pmr::memory_resource* resource)
+        {
+            std::pmr::unordered_map<std::uint32_t, std::uint32_t> inverted(resource);
+            inverted.reserve(ids.size());
+            for (const auto& [key, id] : ids) {
+                inverted[id] = static_cast<std::uint32_t>(key);
+            }
+            return inverted;
+        }
+
+        static void bump_next_id(std::uint32_t& next_id, const std::uint32_t used_id)
+        {
+            next_id = std::max(next_id, used_id + 1);
+        }
+
+        /* track hashes (FNV-1a) */
+        struct track_hasher {
+            std::uint64_t value = 14695981039346656037ULL;
+
+            void add_bytes(const void* data, const std::size_t size)
+            {
+                const unsigned char* bytes = static_cast<const unsigned char*>(data);
+                for (std::size_t i = 0; i < size; ++i) {
+                    value = (value ^ bytes[i]) * 1099511628211ULL;
+                }
+            }
+
+            template <typename value_t>
+            void add(const value_t& v)
+            {
+                add_bytes(&v, sizeof(value_t));
+            }
+
+            void add(const std::string& s)
+            {
+                add(s.size());
+                add_bytes(s.data(), s.size());
+            }
+        };
+
+        // Only the fields read below are hashed, equal hashes mean an identical conversion
+        static std::uint64_t hash_track(const fmtals::project::audio_track& at)
+        {
+            track_hasher h;
+            h.add('a');
+            h.add(at.effective_name);
+            h.add(at.user_name);
+            h.add(at.events_audio_clips.size());
+            for (const auto& ac : at.events_audio_clips) {
+                h.add(static_cast<std::uint32_t>(ac.id));
+                h.add(ac.name);
+                h.add(ac.time);
+                h.add(ac.loop_on);
+                h.add(ac.loop_start);
+                h.add(ac.loop_end);
+            }
+            return h.value;
+        }
+
+        static std::uint64_t hash_track(const fmtals::project::midi_track& mt)
+        {
+            track_hasher h;
+            h.add('m');
+            h.add(mt.effective_name);
+            h.add(mt.user_name);
+            return h.value;
+        }
+
+        static std::uint64_t hash_track(const als_track& ut)
+        {
+            if (const auto* at = std::get_if<fmtals::project::audio_track>(&ut)) {
+                return hash_track(*at);
+            } else if (const auto* mt = std::get_if<fmtals::project::midi_track>(&ut)) {
+                return hash_track(*mt);
+            }
+            return 0;
+        }
+
+        // Writes into a whole project the way a working_project is written, so that one conversion fills either
+        struct project_writer {
+            bool has_mixer_track(const std::uint32_t id) const { return proj.mixer_tracks.count(id) != 0; }
+            bool has_audio_sequencer(const std::uint32_t id) const { return proj.audio_sequencers.count(id) != 0; }
+            bool has_midi_sequencer(const std::uint32_t id) const { return proj.midi_sequencers.count(id) != 0; }
+
+            void set_header(const std::string& name, const decltype(fmtdxc::project::ppq) ppq, const decltype(fmtdxc::project::master_track_id) master_track_id)
+            {
+                proj.name = name;
+                proj.ppq = ppq;
+                proj.master_track_id = master_track_id;
+            }
+
+            void write(const std::uint32_t id, fmtdxc::project::mixer_track&& mt) { proj.mixer_tracks.insert_or_assign(id, std::move(mt)); }
+            void write(const std::uint32_t id, fmtdxc::project::audio_sequencer&& as) { proj.audio_sequencers.insert_or_assign(id, std::move(as)); }
+            void write(const std::uint32_t id, fmtdxc::project::midi_sequencer&& ms) { proj.midi_sequencers.insert_or_assign(id, std::move(ms)); }
+            bool erase_mixer_track(const std::uint32_t id) { return proj.mixer_tracks.erase(id) != 0; }
+            bool erase_audio_sequencer(const std::uint32_t id) { return proj.audio_sequencers.erase(id) != 0; }
+            bool erase_midi_sequencer(const std::uint32_t id) { return proj.midi_sequencers.erase(id) != 0; }
+
+            fmtdxc::project& proj;
+        };
+
+        template <typename out_t>
+        static bool is_converted(const std::unordered_map<std::uint32_t, std::uint32_t>& sequencerIds, const bool isAudio, const als_identity_map& ids, const out_t& out, const std::uint32_t alsId)
+        {
+            const auto seqIt = sequencerIds.find(alsId);
+            const auto mixIt = ids.mixer_tracks.find(alsId);
+            return seqIt != sequencerIds.end() && (isAudio ? out.has_audio_sequencer(seqIt->second) : out.has_midi_sequencer(seqIt->second))
+                && mixIt != ids.mixer_tracks.end() && out.has_mixer_track(mixIt->second);
+        }
+
+        /* worker pool */
+        static std::size_t resolve_thread_count(const conversion_options& options)
+        {
+            return options.thread_count ? options.thread_count : std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        // Runs task(0..count-1) on the pool of the options, or on up to thread_count threads started for this call
+        template <typename task_t>
+        static void parallel_for(const conversion_options& options, const std::size_t count, const task_t& task)
+        {
+            const std::function<void(std::size_t)> job = [&task](const std::size_t i) { task(i); };
+            if (options.pool) {
+                options.pool->run(count, job);
+                return;
+            }
+            const std::size_t workerCount = std::min(resolve_thread_count(options), count);
+            if (workerCount <= 1) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    task(i);
+                }
+                return;
+            }
+            worker_pool(workerCount).run(count, job);
+        }
+
+        /* track conversion */
+
+        // Ids are assigned serially in track order, entities are then built on the workers
+        template <typename project_t>
+        struct converted_track {
+            using audio_track_t = std::conditional_t<std::is_const_v<project_t>, const fmtals::project::audio_track, fmtals::project::audio_track>;
+            using midi_track_t = std::conditional_t<std::is_const_v<project_t>, const fmtals::project::midi_track, fmtals::project::midi_track>;
+
+            explicit converted_track(std::pmr::memory_resource* resource)
+                : clipIds(resource)
+            {
+            }
+
+            audio_track_t* audioSource = nullptr;
+            midi_track_t* midiSource = nullptr;
+            std::uint32_t mixerId = 0;
+            std::uint32_t sequencerId = 0;
+            std::pmr::vector<std::uint32_t> clipIds;
+            fmtdxc::project::mixer_track mixer {};
+            fmtdxc::project::audio_sequencer audio {};
+            fmtdxc::project::midi_sequencer midi {};
+        };
+
+        template <typename slot_t>
+        static void assign_ids(slot_t& slot, typename slot_t::audio_track_t& at, als_identity_map& ids, std::pmr::unordered_set<std::uint64_t>& seenClips)
+        {
+            const std::uint32_t alsId = static_cast<std::uint32_t>(at.id);
+            slot.audioSource = &at;
+            slot.mixerId = acquire_id(ids.mixer_tracks, alsId, ids.next_mixer_track_id);
+            slot.sequencerId = acquire_id(ids.audio_sequencers, alsId, ids.next_audio_sequencer_id);
+            slot.clipIds.reserve(at.events_audio_clips.size());
+            for (const auto& ac : at.events_audio_clips) {
+                const std::uint32_t alsClipId = static_cast<std::uint32_t>(ac.id);
+                const std::uint64_t clipKey = make_clip_key(alsId, alsClipId);
+                bump_next_id(ids.next_als_clip_id, alsClipId);
+                seenClips.insert(clipKey);
+                slot.clipIds.push_back(acquire_id(ids.audio_clips, clipKey, ids.next_audio_clip_id));
+            }
+        }
+
+        template <typename slot_t>
+        static void assign_ids(slot_t& slot, typename slot_t::midi_track_t& mt, als_identity_map& ids)
+        {
+            const std::uint32_t alsId = static_cast<std::uint32_t>(mt.id);
+            slot.midiSource = &mt;
+            slot.mixerId = acquire_id(ids.mixer_tracks, alsId, ids.next_mixer_track_id);
+            slot.sequencerId = acquire_id(ids.midi_sequencers, alsId, ids.next_midi_sequencer_id);
+        }
+
+        template <typename slot_t>
+        static void build_audio_track(slot_t& slot)
+        {
+            auto& at = *slot.audioSource;
+
+            // 1) mixer track
+            slot.mixer.name = take_name(at);
+            slot.mixer.db = 0.0;
+            slot.mixer.pan = 0.0;
+
+            // 2) audio sequencer (output → mixer track)
+            slot.audio.name = slot.mixer.name;
+            slot.audio.output = slot.mixerId;
+
+            // 3) clips
+            for (std::size_t i = 0; i < at.events_audio_clips.size(); ++i) {
+                auto& ac = at.events_audio_clips[i];
+                fmtdxc::project::audio_clip c {};
+                c.name = take(ac.name);
+                c.start_tick = static_cast<std::uint64_t>(ac.time); // minimal mapping
+                c.length_ticks = ac.loop_on ? static_cast<std::uint64_t>(std::max(0.0f, ac.loop_end - ac.loop_start))
+                                            : 0ULL;
+                c.file.clear(); // ALS excerpt doesn’t carry file path
+                c.file_start_frame = 0ULL; // unknown here
+                c.db = 0.0;
+                c.is_loop = ac.loop_on;
+
+                slot.audio.clips.emplace_hint(slot.audio.clips.end(), slot.clipIds[i], std::move(c));
+            }
+
+            // A consumed track is freed right away so both trees never coexist in full
+            release(at.events_audio_clips);
+        }
+
+        template <typename slot_t>
+        static void build_midi_track(slot_t& slot)
+        {
+            auto& mt = *slot.midiSource;
+
+            slot.mixer.name = take_name(mt);
+            slot.mixer.db = 0.0;
+            slot.mixer.pan = 0.0;
+
+            slot.midi.name = slot.mixer.name;
+            slot.midi.instrument.name = "Instrument"; // placeholder; ALS midi clip/instrument payload not provided
+            slot.midi.output = slot.mixerId;
+        }
+
+        // Converts into out in place, tracks whose hash matches the cache are left as they are
+        // and a non-const als is consumed track by track
+        template <typename project_t, typename out_t>
+        static void convert_tracks(project_t& als, als_identity_map& ids, als_conversion_cache* cache, out_t& out, const conversion_options& options)
+        {
+            using slot_t = converted_track<project_t>;
+
+            // ALS ids seen in this conversion, anything else is pruned from the map
+            std::pmr::memory_resource* resource = scratch_resource(options);
+            std::pmr::unordered_set<std::uint32_t> seenTracks(als.tracks.size(), resource);
+            std::pmr::unordered_set<std::uint32_t> convertedTracks(resource);
+            std::pmr::unordered_set<std::uint64_t> seenClips(resource);
+            entity_changes* changes = cache ? &cache->changes : nullptr;
+            if (changes) {
+                changes->mixer_tracks.clear();
+                changes->audio_sequencers.clear();
+                changes->midi_sequencers.clear();
+            }
+
+            // Master mixer track (minimal)
+            {
+                fmtdxc::project::mixer_track master {};
+                master.name = "Master";
+                master.db = 0.0;
+                master.pan = 0.0;
+                if (!ids.master_track_id) {
+                    ids.master_track_id = ids.next_mixer_track_id++;
+                }
+                out.write(ids.master_track_id, std::move(master));
+                out.set_header("Imported Ableton Project", 960, ids.master_track_id); // sensible default ppq; ALS schema doesn’t expose PPQ
+                if (changes) {
+                    changes->mixer_tracks.insert(ids.master_track_id);
+                }
+            }
+
+            // 1) content hashes (parallel)
+            std::pmr::vector<std::uint64_t> hashes(cache ? als.tracks.size() : 0, resource);
+            if (cache) {
+                parallel_for(options, als.tracks.size(), [&](const std::size_t i) {
+                    hashes[i] = hash_track(als.tracks[i]);
+                });
+            }
+
+            // 2) ids of the tracks to convert (serial, track order)
+            std::pmr::vector<slot_t> slots(resource);
+            for (std::size_t i = 0; i < als.tracks.size(); ++i) {
+                auto& ut = als.tracks[i];
+                const std::uint32_t alsId = std::visit([](const auto& t) { return static_cast<std::uint32_t>(t.id); }, ut);
+                bump_next_id(ids.next_als_track_id, alsId);
+                seenTracks.insert(alsId);
+
+                if (std::holds_alternative<fmtals::project::audio_track>(ut)) {
+                    if (cache) {
+                        std::uint64_t& cached = cache->track_hashes[alsId];
+                        if (cached == hashes[i] && is_converted(ids.audio_sequencers, true, ids, out, alsId)) {
+                            continue;
+                        }
+                        cached = hashes[i];
+                    }
+                    convertedTracks.insert(alsId);
+                    assign_ids(slots.emplace_back(resource), std::get<fmtals::project::audio_track>(ut), ids, seenClips);
+                } else if (std::holds_alternative<fmtals::project::midi_track>(ut)) {
+                    if (cache) {
+                        std::uint64_t& cached = cache->track_hashes[alsId];
+                        if (cached == hashes[i] && is_converted(ids.midi_sequencers, false, ids, out, alsId)) {
+                            continue;
+                        }
+                        cached = hashes[i];
+                    }
+                    convertedTracks.insert(alsId);
+                    assign_ids(slots.emplace_back(resource), std::get<fmtals::project::midi_track>(ut), ids);
+                } else {
+                    // group_track / return_track → ignored in this minimal bridge
+                }
+            }
+
+            // 3) entities (parallel)
+            parallel_for(options, slots.size(), [&](const std::size_t i) {
+                if (slots[i].audioSource) {
+                    build_audio_track(slots[i]);
+                } else {
+                    build_midi_track(slots[i]);
+                }
+            });
+
+            // 4) merge (serial, track order)
+            for (slot_t& slot : slots) {
+                out.write(slot.mixerId, std::move(slot.mixer));
+                if (slot.audioSource) {
+                    out.write(slot.sequencerId, std::move(slot.audio));
+                } else {
+                    out.write(slot.sequencerId, std::move(slot.midi));
+                }
+                if (changes) {
+                    changes->mixer_tracks.insert(slot.mixerId);
+                    (slot.audioSource ? changes->audio_sequencers : changes->midi_sequencers).insert(slot.sequencerId);
+                }
+            }
+
+            // Entities of removed tracks leave the project with their ids
+            for (const auto& [alsId, mtId] : ids.mixer_tracks) {
+                if (!seenTracks.count(alsId) && out.erase_mixer_track(mtId) && changes) {
+                    changes->mixer_tracks.insert(mtId);
+                }
+            }
+            for (const auto& [alsId, asId] : ids.audio_sequencers) {
+                if (!seenTracks.count(alsId) && out.erase_audio_sequencer(asId) && changes) {
+                    changes->audio_sequencers.insert(asId);
+                }
+            }
+            for (const auto& [alsId, msId] : ids.midi_sequencers) {
+                if (!seenTracks.count(alsId) && out.erase_midi_sequencer(msId) && changes) {
+                    changes->midi_sequencers.insert(msId);
+                }
+            }
+
+            // Counters only move forward so a removed track's ids are never handed out again
+            prune_ids(ids.mixer_tracks, seenTracks);
+            prune_ids(ids.audio_sequencers, seenTracks);
+            prune_ids(ids.midi_sequencers, seenTracks);
+            for (auto it = ids.audio_clips.begin(); it != ids.audio_clips.end();) {
+                const std::uint32_t alsId = static_cast<std::uint32_t>(it->first >> 32);
+                const bool isKept = seenTracks.count(alsId) && (!convertedTracks.count(alsId) || seenClips.count(it->first));
+                it = isKept ? std::next(it) : ids.audio_clips.erase(it);
+            }
+            if (cache) {
+                for (auto it = cache->track_hashes.begin(); it != cache->track_hashes.end();) {
+                    it = seenTracks.count(it->first) ? std::next(it) : cache->track_hashes.erase(it);
+                }
+            }
+
+            // (Optional) you could inspect als.project_master_track and map its name/db later.
+        }
+
+        // Ids are assigned serially in map order, ALS tracks are then built on the workers
+        struct exported_track {
+            explicit exported_track(std::pmr::memory_resource* resource)
+                : alsClipIds(resource)
+            {
+            }
+
+            const fmtdxc::project::audio_sequencer* audioSource = nullptr;
+            const fmtdxc::project::midi_sequencer* midiSource = nullptr;
+            std::uint32_t alsId = 0;
+            std::pmr::vector<std::uint32_t> alsClipIds;
+            als_track track;
+        };
+
+        // fmtdxc ids → ALS ids from previous conversions
+        struct inverted_identities {
+            std::pmr::unordered_map<std::uint32_t, std::uint32_t> audioTracks;
+            std::pmr::unordered_map<std::uint32_t, std::uint32_t> midiTracks;
+            std::pmr::unordered_map<std::uint32_t, std::uint64_t> clipKeys;
+        };
+
+        static inverted_identities invert_identities(const als_identity_map& ids, std::pmr::memory_resource* resource)
+        {
+            inverted_identities inverted {
+                invert_ids(ids.audio_sequencers, resource),
+                invert_ids(ids.midi_sequencers, resource),
+                std::pmr::unordered_map<std::uint32_t, std::uint64_t>(resource)
+            };
+            inverted.clipKeys.reserve(ids.audio_clips.size());
+            for (const auto& [key, cid] : ids.audio_clips) {
+                inverted.clipKeys[cid] = key;
+            }
+            return inverted;
+        }
+
+        // Known ALS clip id when the clip was imported from this track, a fresh one otherwise
+        static std::uint32_t acquire_als_clip_id(const std::uint32_t alsId, const std::uint32_t cid, als_identity_map& ids, const inverted_identities& inverted)
+        {
+            bump_next_id(ids.next_audio_clip_id, cid);
+            const auto keyIt = inverted.clipKeys.find(cid);
+            const bool isKnown = keyIt != inverted.clipKeys.end() && static_cast<std::uint32_t>(keyIt->second >> 32) == alsId;
+            const std::uint32_t alsClipId = isKnown ? static_cast<std::uint32_t>(keyIt->second) : ids.next_als_clip_id++;
+            ids.audio_clips[make_clip_key(alsId, alsClipId)] = cid;
+            return alsClipId;
+        }
+
+        static void assign_ids(exported_track& slot, const std::uint32_t asid, const fmtdxc::project::audio_sequencer& as, als_identity_map& ids, const inverted_identities& inverted)
+        {
+            bump_next_id(ids.next_audio_sequencer_id, asid);
+            const auto trackIt = inverted.audioTracks.find(asid);
+            const std::uint32_t alsId = trackIt != inverted.audioTracks.end() ? trackIt->second : ids.next_als_track_id++;
+            ids.audio_sequencers[alsId] = asid;
+            ids.mixer_tracks[alsId] = as.output;
+
+            slot.audioSource = &as;
+            slot.alsId = alsId;
+            slot.alsClipIds.reserve(as.clips.size());
+            for (const auto& [cid, c] : as.clips) {
+                slot.alsClipIds.push_back(acquire_als_clip_id(alsId, cid, ids, inverted));
+            }
+        }
+
+        static void assign_ids(exported_track& slot, const std::uint32_t msid, const fmtdxc::project::midi_sequencer& ms, als_identity_map& ids, const inverted_identities& inverted)
+        {
+            bump_next_id(ids.next_midi_sequencer_id, msid);
+            const auto trackIt = inverted.midiTracks.find(msid);
+            const std::uint32_t alsId = trackIt != inverted.midiTracks.end() ? trackIt->second : ids.next_als_track_id++;
+            ids.midi_sequencers[alsId] = msid;
+            ids.mixer_tracks[alsId] = ms.output;
+
+            slot.midiSource = &ms;
+            slot.alsId = alsId;
+        }
+
+        static fmtals::project::audio_clip make_als_clip(const std::uint32_t alsClipId, const fmtdxc::project::audio_clip& c)
+        {
+            fmtals::project::audio_clip ac {};
+            ac.id = alsClipId;
+            ac.name = c.name;
+            ac.time = static_cast<unsigned int>(
+                std::min<std::uint64_t>(c.start_tick, std::numeric_limits<unsigned int>::max()));
+            ac.loop_on = c.is_loop;
+            ac.loop_start = 0.0f;
+            ac.loop_end = static_cast<float>(c.length_ticks);
+            ac.current_start = 0.0f;
+            ac.current_end = static_cast<float>(c.length_ticks);
+            // other ALS fields stay default/zero; fill later if/when you carry more detail
+            return ac;
+        }
+
+        static void build_audio_track(exported_track& slot)
         {
-            return user.empty() ? effective : user;
+            const fmtdxc::project::audio_sequencer& as = *slot.audioSource;
+
+            fmtals::project::audio_track at {};
+            at.id = slot.alsId;
+            at.effective_name = as.name;
+            at.user_name = as.name;
+            at.color = 7;
+            at.color_index = 7;
+
+            // clips
+            at.events_audio_clips.reserve(as.clips.size());
+            std::size_t i = 0;
+            for (const auto& [cid, c] : as.clips) {
+                at.events_audio_clips.push_back(make_als_clip(slot.alsClipIds[i++], c));
+            }
+
+            slot.track = std::move(at);
+        }
+
+        static void build_midi_track(exported_track& slot)
+        {
+            const fmtdxc::project::midi_sequencer& ms = *slot.midiSource;
+
+            fmtals::project::midi_track mt {};
+            mt.id = slot.alsId;
+            mt.effective_name = ms.name;
+            mt.user_name = ms.name;
+            mt.color = 7;
+            mt.color_index = 7;
+
+            slot.track = std::move(mt);
+        }
+
+        /* patching */
+
+        // Compares the fields the conversion carries both ways, anything else never reaches the ALS document
+        static bool is_same_clip(const fmtdxc::project::audio_clip& lhs, const fmtdxc::project::audio_clip& rhs)
+        {
+            return lhs.name == rhs.name
+                && lhs.start_tick == rhs.start_tick
+                && lhs.length_ticks == rhs.length_ticks
+                && lhs.is_loop == rhs.is_loop;
+        }
+
+        static bool is_same_sequencer(const fmtdxc::project::audio_sequencer& lhs, const fmtdxc::project::audio_sequencer& rhs)
+        {
+            return lhs.name == rhs.name
+                && lhs.clips.size() == rhs.clips.size()
+                && std::equal(lhs.clips.begin(), lhs.clips.end(), rhs.clips.begin(), [](const auto& l, const auto& r) {
+                       return l.first == r.first && is_same_clip(l.second, r.second);
+                   });
+        }
+
+        // Only writes the ALS fields whose fmtdxc counterpart changed, loop and warp settings of a kept clip survive
+        static void patch_clip(fmtals::project::audio_clip& ac, const fmtdxc::project::audio_clip* from, const fmtdxc::project::audio_clip& to)
+        {
+            if (!from || from->name != to.name) {
+                ac.name = to.name;
+            }
+            if (!from || from->start_tick != to.start_tick) {
+                ac.time = static_cast<unsigned int>(
+                    std::min<std::uint64_t>(to.start_tick, std::numeric_limits<unsigned int>::max()));
+            }
+            if (!from || from->is_loop != to.is_loop) {
+                ac.loop_on = to.is_loop;
+            }
+            if (!from || from->length_ticks != to.length_ticks) {
+                ac.loop_end = ac.loop_start + static_cast<float>(to.length_ticks);
+                ac.current_end = ac.current_start + static_cast<float>(to.length_ticks);
+            }
+        }
+
+        // Returns whether the track was written
+        static bool patch_track(fmtals::project::audio_track& at, const fmtdxc::project::audio_sequencer* from, const fmtdxc::project::audio_sequencer& to, als_identity_map& ids, const inverted_identities& inverted, std::pmr::memory_resource* resource)
+        {
+            if (from && is_same_sequencer(*from, to)) {
+                return false;
+            }
+            if (!from || from->name != to.name) {
+                at.effective_name = to.name;
+                at.user_name = to.name;
+            }
+
+            const std::uint32_t alsId = static_cast<std::uint32_t>(at.id);
+            std::pmr::unordered_set<std::uint32_t> keptClips(resource);
+            auto& clips = at.events_audio_clips;
+            clips.erase(std::remove_if(clips.begin(), clips.end(), [&](const fmtals::project::audio_clip& ac) {
+                const auto idIt = ids.audio_clips.find(make_clip_key(alsId, static_cast<std::uint32_t>(ac.id)));
+                const bool isKept = idIt != ids.audio_clips.end() && to.clips.count(idIt->second);
+                if (isKept) {
+                    keptClips.insert(idIt->second);
+                }
+                return !isKept;
+            }),
+                clips.end());
+
+            for (auto& ac : clips) {
+                const std::uint32_t cid = ids.audio_clips.at(make_clip_key(alsId, static_cast<std::uint32_t>(ac.id)));
+                const auto fromIt = from ? from->clips.find(cid) : to.clips.end();
+                patch_clip(ac, from && fromIt != from->clips.end() ? &fromIt->second : nullptr, to.clips.at(cid));
+            }
+            for (const auto& [cid, c] : to.clips) {
+                if (!keptClips.count(cid)) {
+                    clips.push_back(make_als_clip(acquire_als_clip_id(alsId, cid, ids, inverted), c));
+                }
+            }
+            return true;
+        }
+
+        static bool patch_track(fmtals::project::midi_track& mt, const fmtdxc::project::midi_sequencer* from, const fmtdxc::project::midi_sequencer& to)
+        {
+            if (from && from->name == to.name) {
+                return false;
+            }
+            mt.effective_name = to.name;
+            mt.user_name = to.name;
+            return true;
+        }
+
+        // The cache entry of every track written here is dropped, its hash would otherwise still match what the DAW
+        // saved before and the next save of that same content would be skipped as already converted
+        static void patch_document(fmtals::project& als, const fmtdxc::project& from, const fmtdxc::project& to, als_identity_map& ids, als_conversion_cache* cache, const conversion_options& options)
+        {
+            std::pmr::memory_resource* resource = scratch_resource(options);
+            const inverted_identities inverted = invert_identities(ids, resource);
+            std::pmr::unordered_set<std::uint32_t> presentAudio(resource);
+            std::pmr::unordered_set<std::uint32_t> presentMidi(resource);
+
+            const auto forget = [&](const std::uint32_t alsId) {
+                if (cache) {
+                    cache->track_hashes.erase(alsId);
+                }
+            };
+
+            // Tracks already in the document are patched in place, or dropped when their sequencer is gone
+            const auto isRemoved = [&](als_track& ut) {
+                const std::uint32_t alsId = std::visit([](const auto& t) { return static_cast<std::uint32_t>(t.id); }, ut);
+                if (auto* at = std::get_if<fmtals::project::audio_track>(&ut)) {
+                    const auto seqIt = ids.audio_sequencers.find(alsId);
+                    if (seqIt == ids.audio_sequencers.end()) {
+                        return false;
+                    }
+                    const auto toIt = to.audio_sequencers.find(seqIt->second);
+                    if (toIt == to.audio_sequencers.end()) {
+                        forget(alsId);
+                        return true;
+                    }
+                    const auto fromIt = from.audio_sequencers.find(seqIt->second);
+                    if (patch_track(*at, fromIt != from.audio_sequencers.end() ? &fromIt->second : nullptr, toIt->second, ids, inverted, resource)) {
+                        forget(alsId);
+                    }
+                    presentAudio.insert(seqIt->second);
+                } else if (auto* mt = std::get_if<fmtals::project::midi_track>(&ut)) {
+                    const auto seqIt = ids.midi_sequencers.find(alsId);
+                    if (seqIt == ids.midi_sequencers.end()) {
+                        return false;
+                    }
+                    const auto toIt = to.midi_sequencers.find(seqIt->second);
+                    if (toIt == to.midi_sequencers.end()) {
+                        forget(alsId);
+                        return true;
+                    }
+                    const auto fromIt = from.midi_sequencers.find(seqIt->second);
+                    if (patch_track(*mt, fromIt != from.midi_sequencers.end() ? &fromIt->second : nullptr, toIt->second)) {
+                        forget(alsId);
+                    }
+                    presentMidi.insert(seqIt->second);
+                }
+                return false;
+            };
+            std::pmr::vector<char> removed(als.tracks.size(), resource);
+            for (std::size_t i = 0; i < als.tracks.size(); ++i) {
+                removed[i] = isRemoved(als.tracks[i]);
+            }
+            std::size_t kept = 0;
+            for (std::size_t i = 0; i < als.tracks.size(); ++i) {
+                if (!removed[i]) {
+                    if (kept != i) {
+                        als.tracks[kept] = std::move(als.tracks[i]);
+                    }
+                    ++kept;
+                }
+            }
+            als.tracks.resize(kept);
+
+            // Sequencers the document doesn't have yet are appended the way convert_to_als builds them
+            for (const auto& [asid, as] : to.audio_sequencers) {
+                if (!presentAudio.count(asid)) {
+                    exported_track slot(resource);
+                    assign_ids(slot, asid, as, ids, inverted);
+                    build_audio_track(slot);
+                    forget(slot.alsId);
+                    als.tracks.push_back(std::move(slot.track));
+                }
+            }
+            for (const auto& [msid, ms] : to.midi_sequencers) {
+                if (!presentMidi.count(msid)) {
+                    exported_track slot(resource);
+                    assign_ids(slot, msid, ms, ids, inverted);
+                    build_midi_track(slot);
+                    forget(slot.alsId);
+                    als.tracks.push_back(std::move(slot.track));
+                }
+            }
         }
 
     } // namespace
 
-    fmtdxc::project convert_from_als(const fmtals::project& als)
+    fmtdxc::project convert_from_als(const fmtals::project& als, const conversion_options& options)
+    {
+        als_identity_map identities {};
+        return convert_from_als(als, identities, options);
+    }
+
+    fmtdxc::project convert_from_als(const fmtals::project& als, als_identity_map& ids, const conversion_options& options)
     {
         fmtdxc::project out {}; // value-init → zeros/defaults
-        out.name = "Imported Ableton Project";
-        out.ppq = 960; // sensible default; ALS schema doesn’t expose PPQ
-
-        // IDs for fmtdxc maps
-        uint32_t nextMixer = 1, nextAudioSeq = 1, nextMidiSeq = 1, nextAudioClip = 1;
-
-        // Master mixer track (minimal)
-        {
-            fmtdxc::project::mixer_track master {};
-            master.name = "Master";
-            master.db = 0.0;
-            master.pan = 0.0;
-            out.mixer_tracks.emplace(nextMixer, master);
-            out.master_track_id = nextMixer;
-            ++nextMixer;
-        }
-
-        // User tracks → sequencers + mixer tracks
-        for (const auto& ut : als.tracks) {
-            if (std::holds_alternative<fmtals::project::audio_track>(ut)) {
-                const auto& at = std::get<fmtals::project::audio_track>(ut);
-
-                // 1) mixer track
-                fmtdxc::project::mixer_track mt {};
-                mt.name = pick_name(at.effective_name, at.user_name);
-                mt.db = 0.0;
-                mt.pan = 0.0;
-                const uint32_t mtId = nextMixer++;
-                out.mixer_tracks.emplace(mtId, mt);
-
-                // 2) audio sequencer (output → mixer track)
-                fmtdxc::project::audio_sequencer as {};
-                as.name = mt.name;
-                as.output = mtId;
-
-                // 3) clips
-                for (const auto& ac : at.events_audio_clips) {
-                    fmtdxc::project::audio_clip c {};
-                    c.name = ac.name;
-                    c.start_tick = static_cast<std::uint64_t>(ac.time); // minimal mapping
-                    c.length_ticks = ac.loop_on ? static_cast<std::uint64_t>(std::max(0.0f, ac.loop_end - ac.loop_start))
-                                                : 0ULL;
-                    c.file.clear(); // ALS excerpt doesn’t carry file path
-                    c.file_start_frame = 0ULL; // unknown here
-                    c.db = 0.0;
-                    c.is_loop = ac.loop_on;
-
-                    as.clips.emplace(nextAudioClip++, std::move(c));
-                }
-
-                out.audio_sequencers.emplace(nextAudioSeq++, std::move(as));
-            } else if (std::holds_alternative<fmtals::project::midi_track>(ut)) {
-                const auto& mt = std::get<fmtals::project::midi_track>(ut);
-
-                fmtdxc::project::mixer_track mix {};
-                mix.name = pick_name(mt.effective_name, mt.user_name);
-                mix.db = 0.0;
-                mix.pan = 0.0;
-                const uint32_t mixId = nextMixer++;
-                out.mixer_tracks.emplace(mixId, mix);
-
-                fmtdxc::project::midi_sequencer ms {};
-                ms.name = mix.name;
-                ms.instrument.name = "Instrument"; // placeholder; ALS midi clip/instrument payload not provided
-                ms.output = mixId;
-
-                out.midi_sequencers.emplace(nextMidiSeq++, std::move(ms));
-            } else {
-                // group_track / return_track → ignored in this minimal bridge
-            }
-        }
+        project_writer writer { out };
+        convert_tracks(als, ids, nullptr, writer, options);
+        return out;
+    }
 
-        // (Optional) you could inspect als.project_master_track and map its name/db later.
+    void convert_from_als(const fmtals::project& als, als_identity_map& ids, als_conversion_cache& cache, fmtdxc::project& proj, const conversion_options& options)
+    {
+        project_writer writer { proj };
+        convert_tracks(als, ids, &cache, writer, options);
+    }
+
+    void convert_from_als(const fmtals::project& als, als_identity_map& ids, als_conversion_cache& cache, working_project& proj, const conversion_options& options)
+    {
+        convert_tracks(als, ids, &cache, proj, options);
+    }
+
+    fmtdxc::project convert_from_als(fmtals::project&& als, const conversion_options& options)
+    {
+        als_identity_map identities {};
+        return convert_from_als(std::move(als), identities, options);
+    }
 
+    fmtdxc::project convert_from_als(fmtals::project&& als, als_identity_map& ids, const conversion_options& options)
+    {
+        fmtdxc::project out {}; // value-init → zeros/defaults
+        project_writer writer { out };
+        convert_tracks(als, ids, nullptr, writer, options);
+        als.tracks.clear();
         return out;
     }
 
-    fmtals::project convert_to_als(const fmtdxc::project& proj)
+    void convert_from_als(fmtals::project&& als, als_identity_map& ids, als_conversion_cache& cache, fmtdxc::project& proj, const conversion_options& options)
+    {
+        project_writer writer { proj };
+        convert_tracks(als, ids, &cache, writer, options);
+        als.tracks.clear();
+    }
+
+    void convert_from_als(fmtals::project&& als, als_identity_map& ids, als_conversion_cache& cache, working_project& proj, const conversion_options& options)
+    {
+        convert_tracks(als, ids, &cache, proj, options);
+        als.tracks.clear();
+    }
+
+    fmtals::project convert_to_als(const fmtdxc::project& proj, const conversion_options& options)
+    {
+        als_identity_map identities {};
+        return convert_to_als(proj, identities, options);
+    }
+
+    fmtals::project convert_to_als(const fmtdxc::project& proj, als_identity_map& ids, const conversion_options& options)
     {
         fmtals::project als {}; // value-init → zero-initialize mandatory scalars
 
+        // fmtdxc ids → ALS ids from previous conversions, anything missing gets a fresh ALS id
+        std::pmr::memory_resource* resource = scratch_resource(options);
+        const inverted_identities inverted = invert_identities(ids, resource);
+
+        // Keep fmtdxc counters ahead of every id the project already uses
+        ids.master_track_id = proj.master_track_id;
+        for (const auto& [mtid, mt] : proj.mixer_tracks) {
+            bump_next_id(ids.next_mixer_track_id, mtid);
+        }
+
         // Minimal project metadata
         als.creator = "Ableton Live 9.7.7";
         als.major_version = "4";
@@ -118,40 +829,30 @@ namespace detail {
         als.project_prehear_track.color = 7;
         als.project_prehear_track.color_index = 7;
 
+        std::pmr::vector<exported_track> slots(resource);
+        slots.reserve(proj.audio_sequencers.size() + proj.midi_sequencers.size());
+
         // fmtdxc audio sequencers → ALS audio tracks
         for (const auto& [asid, as] : proj.audio_sequencers) {
-            fmtals::project::audio_track at {};
-            at.effective_name = as.name;
-            at.user_name = as.name;
-            at.color = 7;
-            at.color_index = 7;
-
-            // clips
-            for (const auto& [cid, c] : as.clips) {
-                fmtals::project::audio_clip ac {};
-                ac.name = c.name;
-                ac.time = static_cast<unsigned int>(
-                    std::min<std::uint64_t>(c.start_tick, std::numeric_limits<unsigned int>::max()));
-                ac.loop_on = c.is_loop;
-                ac.loop_start = 0.0f;
-                ac.loop_end = static_cast<float>(c.length_ticks);
-                ac.current_start = 0.0f;
-                ac.current_end = static_cast<float>(c.length_ticks);
-                // other ALS fields stay default/zero; fill later if/when you carry more detail
-                at.events_audio_clips.push_back(std::move(ac));
-            }
-
-            als.tracks.push_back(std::move(at));
+            assign_ids(slots.emplace_back(resource), asid, as, ids, inverted);
         }
 
         // fmtdxc midi sequencers → ALS midi tracks (clips omitted in current fmtdxc schema)
         for (const auto& [msid, ms] : proj.midi_sequencers) {
-            fmtals::project::midi_track mt {};
-            mt.effective_name = ms.name;
-            mt.user_name = ms.name;
-            mt.color = 7;
-            mt.color_index = 7;
-            als.tracks.push_back(std::move(mt));
+            assign_ids(slots.emplace_back(resource), msid, ms, ids, inverted);
+        }
+
+        parallel_for(options, slots.size(), [&](const std::size_t i) {
+            if (slots[i].audioSource) {
+                build_audio_track(slots[i]);
+            } else {
+                build_midi_track(slots[i]);
+            }
+        });
+
+        als.tracks.reserve(slots.size());
+        for (exported_track& slot : slots) {
+            als.tracks.push_back(std::move(slot.track));
         }
 
         als.transport_computer_keyboard_is_enabled = false;
@@ -165,5 +866,15 @@ namespace detail {
 
         return als;
     }
+
+    void patch_als(fmtals::project& als, const fmtdxc::project& from, const fmtdxc::project& to, als_identity_map& ids, const conversion_options& options)
+    {
+        patch_document(als, from, to, ids, nullptr, options);
+    }
+
+    void patch_als(fmtals::project& als, const fmtdxc::project& from, const fmtdxc::project& to, als_identity_map& ids, als_conversion_cache& cache, const conversion_options& options)
+    {
+        patch_document(als, from, to, ids, &cache, options);
+    }
 }
 }
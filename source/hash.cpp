@@ -0,0 +1,235 @@
+#include <rtdxc/rtdxc.hpp>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+
+#include <ostream>
+#include <streambuf>
+
+namespace rtdxc {
+namespace detail {
+
+    namespace {
+
+        // FNV-1a over the bytes cereal writes, nothing is buffered
+        struct hashing_buffer : std::streambuf {
+            std::uint64_t hash = 1469598103934665603ull;
+
+            int_type overflow(const int_type c) override
+            {
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    mix(traits_type::to_char_type(c));
+                }
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char* data, const std::streamsize count) override
+            {
+                for (std::streamsize i = 0; i < count; ++i) {
+                    mix(data[i]);
+                }
+                return count;
+            }
+
+            void mix(const char c)
+            {
+                hash ^= static_cast<unsigned char>(c);
+                hash *= 1099511628211ull;
+            }
+        };
+
+        // One stream for every entity of a pass, constructing a std::ostream costs more than hashing a small entity
+        struct entity_hasher {
+            entity_hasher()
+                : stream(&buffer)
+            {
+            }
+
+            template <typename value_t>
+            std::uint64_t operator()(const value_t& value)
+            {
+                buffer.hash = 1469598103934665603ull;
+                cereal::BinaryOutputArchive archive(stream);
+                archive(value);
+                return buffer.hash;
+            }
+
+            hashing_buffer buffer;
+            std::ostream stream;
+        };
+
+        // splitmix64 finalizer, roots add these up so that entities can enter and leave in any order
+        std::uint64_t mix_entry(const std::uint32_t id, const std::uint64_t hash)
+        {
+            std::uint64_t z = hash + 0x9e3779b97f4a7c15ull * (static_cast<std::uint64_t>(id) + 1);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+        std::uint64_t hash_header(const fmtdxc::project& proj, entity_hasher& hasher)
+        {
+            return hasher(proj.name) ^ mix_entry(proj.master_track_id, hasher(proj.ppq));
+        }
+
+        template <typename map_t>
+        void hash_map(const map_t& entities, std::unordered_map<std::uint32_t, std::uint64_t>& hashes, std::uint64_t& root, entity_hasher& hasher)
+        {
+            hashes.clear();
+            hashes.reserve(entities.size());
+            root = 0;
+            for (const auto& [id, entity] : entities) {
+                const std::uint64_t hash = hasher(entity);
+                hashes.emplace(id, hash);
+                root += mix_entry(id, hash);
+            }
+        }
+
+        template <typename map_t>
+        void rehash_map(const map_t& entities, const std::unordered_set<std::uint32_t>& changed, std::unordered_map<std::uint32_t, std::uint64_t>& hashes, std::uint64_t& root, entity_hasher& hasher)
+        {
+            for (const std::uint32_t id : changed) {
+                const auto previous = hashes.find(id);
+                if (previous != hashes.end()) {
+                    root -= mix_entry(id, previous->second);
+                }
+                const auto entity = entities.find(id);
+                if (entity == entities.end()) {
+                    if (previous != hashes.end()) {
+                        hashes.erase(previous);
+                    }
+                    continue;
+                }
+                const std::uint64_t hash = hasher(entity->second);
+                hashes[id] = hash;
+                root += mix_entry(id, hash);
+            }
+        }
+
+        std::uint64_t combine_roots(const project_hashes& hashes)
+        {
+            return mix_entry(0, hashes.header) ^ mix_entry(1, hashes.mixer_tracks_root)
+                ^ mix_entry(2, hashes.audio_sequencers_root) ^ mix_entry(3, hashes.midi_sequencers_root);
+        }
+
+        void insert_ids(const std::unordered_map<std::uint32_t, std::uint64_t>& hashes, std::unordered_set<std::uint32_t>& ids)
+        {
+            for (const auto& [id, hash] : hashes) {
+                ids.insert(id);
+            }
+        }
+
+        // Missing on one side counts as different, missing on both means the candidate was written then erased
+        void collect_changed(const std::unordered_map<std::uint32_t, std::uint64_t>& fromHashes, const std::unordered_map<std::uint32_t, std::uint64_t>& toHashes,
+            const std::unordered_set<std::uint32_t>& candidates, std::unordered_set<std::uint32_t>& changed)
+        {
+            for (const std::uint32_t id : candidates) {
+                const auto fromHash = fromHashes.find(id);
+                const auto toHash = toHashes.find(id);
+                const bool isInFrom = fromHash != fromHashes.end();
+                const bool isInTo = toHash != toHashes.end();
+                if ((isInFrom || isInTo) && !(isInFrom && isInTo && fromHash->second == toHash->second)) {
+                    changed.insert(id);
+                }
+            }
+        }
+
+        template <typename map_t>
+        void copy_changed(const map_t& entities, const std::unordered_set<std::uint32_t>& changed, map_t& pruned)
+        {
+            for (const std::uint32_t id : changed) {
+                const auto entity = entities.find(id);
+                if (entity != entities.end()) {
+                    pruned.emplace(id, entity->second);
+                }
+            }
+        }
+
+    }
+
+    void hash_project(const fmtdxc::project& proj, project_hashes& hashes)
+    {
+        entity_hasher hasher;
+        hashes.header = hash_header(proj, hasher);
+        hash_map(proj.mixer_tracks, hashes.mixer_tracks, hashes.mixer_tracks_root, hasher);
+        hash_map(proj.audio_sequencers, hashes.audio_sequencers, hashes.audio_sequencers_root, hasher);
+        hash_map(proj.midi_sequencers, hashes.midi_sequencers, hashes.midi_sequencers_root, hasher);
+        hashes.root = combine_roots(hashes);
+    }
+
+    void rehash_project(const fmtdxc::project& proj, const entity_changes& changes, project_hashes& hashes)
+    {
+        entity_hasher hasher;
+        hashes.header = hash_header(proj, hasher);
+        rehash_map(proj.mixer_tracks, changes.mixer_tracks, hashes.mixer_tracks, hashes.mixer_tracks_root, hasher);
+        rehash_map(proj.audio_sequencers, changes.audio_sequencers, hashes.audio_sequencers, hashes.audio_sequencers_root, hasher);
+        rehash_map(proj.midi_sequencers, changes.midi_sequencers, hashes.midi_sequencers, hashes.midi_sequencers_root, hasher);
+        hashes.root = combine_roots(hashes);
+    }
+
+    entity_changes get_changed_entities(const project_hashes& from_hashes, const project_hashes& to_hashes, const entity_changes& candidates)
+    {
+        entity_changes changed;
+        if (from_hashes.root == to_hashes.root) {
+            return changed;
+        }
+        if (from_hashes.mixer_tracks_root != to_hashes.mixer_tracks_root) {
+            collect_changed(from_hashes.mixer_tracks, to_hashes.mixer_tracks, candidates.mixer_tracks, changed.mixer_tracks);
+        }
+        if (from_hashes.audio_sequencers_root != to_hashes.audio_sequencers_root) {
+            collect_changed(from_hashes.audio_sequencers, to_hashes.audio_sequencers, candidates.audio_sequencers, changed.audio_sequencers);
+        }
+        if (from_hashes.midi_sequencers_root != to_hashes.midi_sequencers_root) {
+            collect_changed(from_hashes.midi_sequencers, to_hashes.midi_sequencers, candidates.midi_sequencers, changed.midi_sequencers);
+        }
+        return changed;
+    }
+
+    entity_changes get_changed_entities(const project_hashes& from_hashes, const project_hashes& to_hashes)
+    {
+        entity_changes candidates;
+        insert_ids(from_hashes.mixer_tracks, candidates.mixer_tracks);
+        insert_ids(to_hashes.mixer_tracks, candidates.mixer_tracks);
+        insert_ids(from_hashes.audio_sequencers, candidates.audio_sequencers);
+        insert_ids(to_hashes.audio_sequencers, candidates.audio_sequencers);
+        insert_ids(from_hashes.midi_sequencers, candidates.midi_sequencers);
+        insert_ids(to_hashes.midi_sequencers, candidates.midi_sequencers);
+        return get_changed_entities(from_hashes, to_hashes, candidates);
+    }
+
+    void update_commit_hashes(const std::vector<fmtdxc::project_commit>& commits, std::vector<std::uint64_t>& hashes)
+    {
+        // hashes[i] identifies the first i commits, so two histories sharing a hash share every commit up to it
+        if (hashes.empty()) {
+            hashes.push_back(0);
+        }
+        entity_hasher hasher;
+        hashes.reserve(commits.size() + 1);
+        for (std::size_t i = hashes.size(); i <= commits.size(); ++i) {
+            hashes.push_back(mix_entry(static_cast<std::uint32_t>(i), hasher(commits[i - 1]) ^ hashes.back()));
+        }
+    }
+
+    void diff(const fmtdxc::project& from, const project_hashes& from_hashes, const fmtdxc::project& to, const project_hashes& to_hashes, const entity_changes& candidates, fmtdxc::sparse_project& result)
+    {
+        // Entities equal on both sides contribute nothing to a diff, so fmtdxc::diff only ever sees the ones that changed
+        const entity_changes changed = get_changed_entities(from_hashes, to_hashes, candidates);
+        fmtdxc::project prunedFrom;
+        fmtdxc::project prunedTo;
+        prunedFrom.name = from.name;
+        prunedFrom.ppq = from.ppq;
+        prunedFrom.master_track_id = from.master_track_id;
+        prunedTo.name = to.name;
+        prunedTo.ppq = to.ppq;
+        prunedTo.master_track_id = to.master_track_id;
+        copy_changed(from.mixer_tracks, changed.mixer_tracks, prunedFrom.mixer_tracks);
+        copy_changed(to.mixer_tracks, changed.mixer_tracks, prunedTo.mixer_tracks);
+        copy_changed(from.audio_sequencers, changed.audio_sequencers, prunedFrom.audio_sequencers);
+        copy_changed(to.audio_sequencers, changed.audio_sequencers, prunedTo.audio_sequencers);
+        copy_changed(from.midi_sequencers, changed.midi_sequencers, prunedFrom.midi_sequencers);
+        copy_changed(to.midi_sequencers, changed.midi_sequencers, prunedTo.midi_sequencers);
+        fmtdxc::diff(prunedFrom, prunedTo, result);
+    }
+
+}
+}
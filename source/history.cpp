@@ -0,0 +1,638 @@
+#include <rtdxc/rtdxc.hpp>
+
+#include <cereal/archives/binary.hpp>
+
+#include <deque>
+#include <list>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <streambuf>
+
+namespace rtdxc {
+namespace detail {
+
+    namespace {
+
+        using mixer_track_node = std::shared_ptr<const interned<fmtdxc::project::mixer_track>>;
+        using audio_clip_node = std::shared_ptr<const interned<fmtdxc::project::audio_clip>>;
+        using midi_sequencer_node = std::shared_ptr<const interned<fmtdxc::project::midi_sequencer>>;
+
+        struct audio_sequencer_fields {
+            std::shared_ptr<const interned<fmtdxc::project::audio_sequencer>> fields; // clips left empty, they are shared one by one below
+            std::map<std::uint32_t, audio_clip_node> clips;
+        };
+        using audio_sequencer_node = std::shared_ptr<const audio_sequencer_fields>;
+
+        // Copies share every track, sequencer and clip node, so a state costs its map nodes plus what its commit changed
+        struct shared_project {
+            symbol name = 0;
+            decltype(fmtdxc::project::ppq) ppq {};
+            decltype(fmtdxc::project::master_track_id) master_track_id {};
+            std::map<std::uint32_t, mixer_track_node> mixer_tracks;
+            std::map<std::uint32_t, audio_sequencer_node> audio_sequencers;
+            std::map<std::uint32_t, midi_sequencer_node> midi_sequencers;
+        };
+
+        template <typename node_t>
+        using node_writes = std::vector<std::pair<std::uint32_t, node_t>>; // null means erased
+
+        // What a commit wrote over the state before it, its nodes are shared with the states that follow
+        struct project_delta {
+            symbol name = 0;
+            decltype(fmtdxc::project::ppq) ppq {};
+            decltype(fmtdxc::project::master_track_id) master_track_id {};
+            node_writes<mixer_track_node> mixer_tracks;
+            node_writes<audio_sequencer_node> audio_sequencers;
+            node_writes<midi_sequencer_node> midi_sequencers;
+            std::chrono::system_clock::time_point time; // the epoch when unknown
+        };
+
+        // Appends what cereal writes to a string that keeps its capacity between clips
+        struct bytes_buffer : std::streambuf {
+            std::string bytes;
+
+            int_type overflow(const int_type c) override
+            {
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    bytes.push_back(traits_type::to_char_type(c));
+                }
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char* data, const std::streamsize count) override
+            {
+                bytes.append(data, static_cast<std::size_t>(count));
+                return count;
+            }
+        };
+
+        // Clips have no equality of their own, their names compare as symbols and the cereal bytes of the rest stand in for it
+        struct clip_comparer {
+            clip_comparer()
+                : lhsStream(&lhsBuffer)
+                , rhsStream(&rhsBuffer)
+            {
+            }
+
+            bool operator()(const interned<fmtdxc::project::audio_clip>& lhs, const interned<fmtdxc::project::audio_clip>& rhs)
+            {
+                if (lhs.names != rhs.names) {
+                    return false;
+                }
+                write(lhs.fields, lhsBuffer, lhsStream);
+                write(rhs.fields, rhsBuffer, rhsStream);
+                return lhsBuffer.bytes == rhsBuffer.bytes;
+            }
+
+            static void write(const fmtdxc::project::audio_clip& clip, bytes_buffer& buffer, std::ostream& stream)
+            {
+                buffer.bytes.clear();
+                cereal::BinaryOutputArchive archive(stream);
+                archive(clip);
+            }
+
+            bytes_buffer lhsBuffer;
+            bytes_buffer rhsBuffer;
+            std::ostream lhsStream;
+            std::ostream rhsStream;
+        };
+
+        mixer_track_node make_node(const fmtdxc::project::mixer_track& mt, const mixer_track_node*, symbol_table& symbols, clip_comparer&)
+        {
+            return std::make_shared<const interned<fmtdxc::project::mixer_track>>(intern_names(mt, symbols));
+        }
+
+        midi_sequencer_node make_node(const fmtdxc::project::midi_sequencer& ms, const midi_sequencer_node*, symbol_table& symbols, clip_comparer&)
+        {
+            return std::make_shared<const interned<fmtdxc::project::midi_sequencer>>(intern_names(ms, symbols));
+        }
+
+        // Clips equal to the ones of the previous node are shared with it
+        audio_sequencer_node make_node(const fmtdxc::project::audio_sequencer& as, const audio_sequencer_node* previous, symbol_table& symbols, clip_comparer& compare)
+        {
+            auto node = std::make_shared<audio_sequencer_fields>();
+            fmtdxc::project::audio_sequencer fields = as;
+            fields.clips.clear();
+            node->fields = std::make_shared<const interned<fmtdxc::project::audio_sequencer>>(intern_names(fields, symbols));
+            for (const auto& [cid, c] : as.clips) {
+                interned<fmtdxc::project::audio_clip> clip = intern_names(c, symbols);
+                if (previous && *previous) {
+                    const auto old = (*previous)->clips.find(cid);
+                    if (old != (*previous)->clips.end() && compare(*old->second, clip)) {
+                        node->clips.emplace_hint(node->clips.end(), cid, old->second);
+                        continue;
+                    }
+                }
+                node->clips.emplace_hint(node->clips.end(), cid, std::make_shared<const interned<fmtdxc::project::audio_clip>>(std::move(clip)));
+            }
+            return node;
+        }
+
+        fmtdxc::project::mixer_track materialize(const mixer_track_node& node, const symbol_table& symbols)
+        {
+            return resolve_names(*node, symbols);
+        }
+
+        fmtdxc::project::midi_sequencer materialize(const midi_sequencer_node& node, const symbol_table& symbols)
+        {
+            return resolve_names(*node, symbols);
+        }
+
+        fmtdxc::project::audio_sequencer materialize(const audio_sequencer_node& node, const symbol_table& symbols)
+        {
+            fmtdxc::project::audio_sequencer as = resolve_names(*node->fields, symbols);
+            for (const auto& [cid, c] : node->clips) {
+                as.clips.emplace_hint(as.clips.end(), cid, resolve_names(*c, symbols));
+            }
+            return as;
+        }
+
+        // Sequencer names first then those of the clips in id order, the layout intern_names gives a whole sequencer
+        interned<fmtdxc::project::audio_sequencer> join_clips(const audio_sequencer_node& node)
+        {
+            interned<fmtdxc::project::audio_sequencer> as = *node->fields;
+            for (const auto& [cid, c] : node->clips) {
+                as.fields.clips.emplace_hint(as.fields.clips.end(), cid, c->fields);
+                as.names.insert(as.names.end(), c->names.begin(), c->names.end());
+            }
+            return as;
+        }
+
+        // Brings the changed entities in line with proj, every other node stays shared
+        template <typename map_t, typename node_t>
+        void assign_entities(const map_t& entities, const std::unordered_set<std::uint32_t>& changed, std::map<std::uint32_t, node_t>& nodes, symbol_table& symbols, clip_comparer& compare)
+        {
+            for (const std::uint32_t id : changed) {
+                const auto entity = entities.find(id);
+                const auto node = nodes.find(id);
+                if (entity == entities.end()) {
+                    if (node != nodes.end()) {
+                        nodes.erase(node);
+                    }
+                } else if (node == nodes.end()) {
+                    nodes.emplace(id, make_node(entity->second, nullptr, symbols, compare));
+                } else {
+                    node->second = make_node(entity->second, &node->second, symbols, compare);
+                }
+            }
+        }
+
+        void assign_changes(const fmtdxc::project& proj, const entity_changes& changes, symbol_table& symbols, shared_project& state)
+        {
+            clip_comparer compare;
+            state.name = symbols.intern(proj.name);
+            state.ppq = proj.ppq;
+            state.master_track_id = proj.master_track_id;
+            assign_entities(proj.mixer_tracks, changes.mixer_tracks, state.mixer_tracks, symbols, compare);
+            assign_entities(proj.audio_sequencers, changes.audio_sequencers, state.audio_sequencers, symbols, compare);
+            assign_entities(proj.midi_sequencers, changes.midi_sequencers, state.midi_sequencers, symbols, compare);
+        }
+
+        template <typename node_t>
+        void record_writes(const std::map<std::uint32_t, node_t>& nodes, const std::unordered_set<std::uint32_t>& changed, node_writes<node_t>& writes)
+        {
+            writes.reserve(changed.size());
+            for (const std::uint32_t id : changed) {
+                const auto node = nodes.find(id);
+                writes.emplace_back(id, node == nodes.end() ? nullptr : node->second);
+            }
+        }
+
+        project_delta make_delta(const shared_project& state, const entity_changes& changes, const std::chrono::system_clock::time_point time)
+        {
+            project_delta delta;
+            delta.time = time;
+            delta.name = state.name;
+            delta.ppq = state.ppq;
+            delta.master_track_id = state.master_track_id;
+            record_writes(state.mixer_tracks, changes.mixer_tracks, delta.mixer_tracks);
+            record_writes(state.audio_sequencers, changes.audio_sequencers, delta.audio_sequencers);
+            record_writes(state.midi_sequencers, changes.midi_sequencers, delta.midi_sequencers);
+            return delta;
+        }
+
+        template <typename node_t>
+        void apply_writes(const node_writes<node_t>& writes, std::map<std::uint32_t, node_t>& nodes)
+        {
+            for (const auto& [id, node] : writes) {
+                if (node) {
+                    nodes.insert_or_assign(id, node);
+                } else {
+                    nodes.erase(id);
+                }
+            }
+        }
+
+        void apply_delta(const project_delta& delta, shared_project& state)
+        {
+            state.name = delta.name;
+            state.ppq = delta.ppq;
+            state.master_track_id = delta.master_track_id;
+            apply_writes(delta.mixer_tracks, state.mixer_tracks);
+            apply_writes(delta.audio_sequencers, state.audio_sequencers);
+            apply_writes(delta.midi_sequencers, state.midi_sequencers);
+        }
+
+        template <typename map_t, typename node_t>
+        void materialize_entities(const std::map<std::uint32_t, node_t>& nodes, const symbol_table& symbols, map_t& entities)
+        {
+            for (const auto& [id, node] : nodes) {
+                entities.emplace_hint(entities.end(), id, materialize(node, symbols));
+            }
+        }
+
+        fmtdxc::project materialize(const shared_project& state, const symbol_table& symbols)
+        {
+            fmtdxc::project proj;
+            proj.name = symbols.get_text(state.name);
+            proj.ppq = state.ppq;
+            proj.master_track_id = state.master_track_id;
+            materialize_entities(state.mixer_tracks, symbols, proj.mixer_tracks);
+            materialize_entities(state.audio_sequencers, symbols, proj.audio_sequencers);
+            materialize_entities(state.midi_sequencers, symbols, proj.midi_sequencers);
+            return proj;
+        }
+
+        // Patches carry interned entities too, only the clips of a sequencer are joined back to it
+        template <typename node_t, typename entity_t>
+        void copy_writes(const node_writes<node_t>& writes, entity_writes<interned<entity_t>>& entities)
+        {
+            entities.reserve(writes.size());
+            for (const auto& [id, node] : writes) {
+                entities.emplace_back(id, node ? std::optional<interned<entity_t>>(*node) : std::nullopt);
+            }
+        }
+
+        void copy_writes(const node_writes<audio_sequencer_node>& writes, entity_writes<interned<fmtdxc::project::audio_sequencer>>& entities)
+        {
+            entities.reserve(writes.size());
+            for (const auto& [id, node] : writes) {
+                entities.emplace_back(id, node ? std::optional<interned<fmtdxc::project::audio_sequencer>>(join_clips(node)) : std::nullopt);
+            }
+        }
+
+        // Points the changed entities at the nodes a working project wrote, nothing is interned again
+        template <typename node_t>
+        void adopt_entities(const std::map<std::uint32_t, node_t>& written, const std::unordered_set<std::uint32_t>& changed, std::map<std::uint32_t, node_t>& nodes)
+        {
+            for (const std::uint32_t id : changed) {
+                const auto node = written.find(id);
+                if (node == written.end()) {
+                    nodes.erase(id);
+                } else {
+                    nodes.insert_or_assign(id, node->second);
+                }
+            }
+        }
+
+        template <typename map_t, typename node_t>
+        void materialize_entities(const std::map<std::uint32_t, node_t>& nodes, const std::unordered_set<std::uint32_t>& ids, const symbol_table& symbols, map_t& entities)
+        {
+            for (const std::uint32_t id : ids) {
+                const auto node = nodes.find(id);
+                if (node != nodes.end()) {
+                    entities.emplace(id, materialize(node->second, symbols));
+                }
+            }
+        }
+
+        template <typename node_t>
+        bool erase_node(const std::uint32_t id, std::map<std::uint32_t, node_t>& nodes)
+        {
+            return nodes.erase(id) != 0;
+        }
+
+        template <typename map_t>
+        void insert_ids(const map_t& entities, std::unordered_set<std::uint32_t>& ids)
+        {
+            for (const auto& [id, entity] : entities) {
+                ids.insert(id);
+            }
+        }
+
+        entity_changes get_all_entities(const fmtdxc::project& proj)
+        {
+            entity_changes changes;
+            insert_ids(proj.mixer_tracks, changes.mixer_tracks);
+            insert_ids(proj.audio_sequencers, changes.audio_sequencers);
+            insert_ids(proj.midi_sequencers, changes.midi_sequencers);
+            return changes;
+        }
+
+    }
+
+    struct project_history_impl {
+        using state = std::shared_ptr<const fmtdxc::project>;
+
+        // Replaying from the closest checkpoint only moves node pointers around
+        shared_project build(const std::size_t index) const
+        {
+            const auto checkpoint = std::prev(checkpoints.upper_bound(index));
+            shared_project built = checkpoint->second;
+            for (std::size_t replayed = checkpoint->first; replayed < index; ++replayed) {
+                apply_delta(deltas[replayed - first_index], built);
+            }
+            return built;
+        }
+
+        void touch(const std::size_t index, const state& built)
+        {
+            const auto entry = cache_entries.find(index);
+            if (entry != cache_entries.end()) {
+                cache.splice(cache.begin(), cache, entry->second);
+                return;
+            }
+            cache.emplace_front(index, built);
+            cache_entries.emplace(index, cache.begin());
+            if (cache.size() > cache_capacity) {
+                cache_entries.erase(cache.back().first);
+                cache.pop_back();
+            }
+        }
+
+        // Committing after an undo drops the states that could have been redone
+        void drop_after(const std::size_t index)
+        {
+            if (index == first_index + deltas.size()) {
+                return;
+            }
+            last = build(index);
+            deltas.resize(index - first_index);
+            checkpoints.erase(checkpoints.upper_bound(index), checkpoints.end());
+            std::lock_guard<std::mutex> lock(cache_mutex);
+            forget_after(index);
+        }
+
+        void push_delta(const std::size_t index, const entity_changes& changes, const std::chrono::system_clock::time_point time)
+        {
+            deltas.push_back(make_delta(last, changes, time));
+            if (index % checkpoint_interval == 0) {
+                checkpoints.emplace(index, last);
+            }
+        }
+
+        void forget_after(const std::size_t index)
+        {
+            for (auto it = cache.begin(); it != cache.end();) {
+                if (it->first > index) {
+                    cache_entries.erase(it->first);
+                    it = cache.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        std::size_t first_index = 0;
+        std::size_t checkpoint_interval = 1;
+        std::size_t cache_capacity = 0;
+        symbol_table symbols; // names of every node below
+        std::deque<project_delta> deltas; // deltas[i] leads from state first_index + i to the next one
+        std::map<std::size_t, shared_project> checkpoints; // always holds first_index
+        shared_project last; // state at the last index, commits are assigned onto it
+        std::mutex cache_mutex; // const getters fill the cache
+        std::list<std::pair<std::size_t, state>> cache; // most recently handed out first
+        std::unordered_map<std::size_t, std::list<std::pair<std::size_t, state>>::iterator> cache_entries;
+    };
+
+    // Holds the history so that the nodes and symbols it writes stay those of the history it commits to
+    struct working_project_impl {
+        std::shared_ptr<project_history_impl> history;
+        shared_project state;
+        clip_comparer compare;
+    };
+
+    project_history::project_history(const fmtdxc::project& proj, const std::size_t index, const std::size_t checkpoint_interval, const std::size_t cache_capacity)
+        : _impl(std::make_shared<project_history_impl>())
+    {
+        if (!checkpoint_interval) {
+            throw std::invalid_argument("Checkpoint interval provided to project history is zero");
+        }
+        _impl->first_index = index;
+        _impl->checkpoint_interval = checkpoint_interval;
+        _impl->cache_capacity = cache_capacity;
+        assign_changes(proj, get_all_entities(proj), _impl->symbols, _impl->last);
+        _impl->checkpoints.emplace(index, _impl->last);
+    }
+
+    std::size_t project_history::get_first_index() const
+    {
+        return _impl->first_index;
+    }
+
+    std::size_t project_history::get_last_index() const
+    {
+        return _impl->first_index + _impl->deltas.size();
+    }
+
+    bool project_history::contains(const std::size_t index) const
+    {
+        return index >= get_first_index() && index <= get_last_index();
+    }
+
+    std::size_t project_history::get_checkpoint_interval() const
+    {
+        return _impl->checkpoint_interval;
+    }
+
+    std::size_t project_history::get_checkpoint_count() const
+    {
+        return _impl->checkpoints.size();
+    }
+
+    std::size_t project_history::get_cached_count() const
+    {
+        std::lock_guard<std::mutex> lock(_impl->cache_mutex);
+        return _impl->cache.size();
+    }
+
+    std::shared_ptr<const fmtdxc::project> project_history::get_project(const std::size_t index) const
+    {
+        if (!contains(index)) {
+            throw std::invalid_argument("Index provided to project history is out of range");
+        }
+        std::lock_guard<std::mutex> lock(_impl->cache_mutex);
+        const auto cached = _impl->cache_entries.find(index);
+        const std::shared_ptr<const fmtdxc::project> built = cached != _impl->cache_entries.end()
+            ? cached->second->second
+            : std::make_shared<const fmtdxc::project>(materialize(_impl->build(index), _impl->symbols));
+        _impl->touch(index, built);
+        return built;
+    }
+
+    std::chrono::system_clock::time_point project_history::get_commit_time(const std::size_t index) const
+    {
+        if (index <= get_first_index() || index > get_last_index()) {
+            throw std::invalid_argument("Index provided to project history commit time is not a commit of the history");
+        }
+        return _impl->deltas[index - 1 - _impl->first_index].time;
+    }
+
+    commit_patch project_history::get_commit_patch(const std::size_t index, const std::string& message) const
+    {
+        if (index <= get_first_index() || index > get_last_index()) {
+            throw std::invalid_argument("Index provided to project history commit patch is not a commit of the history");
+        }
+        const project_delta& delta = _impl->deltas[index - 1 - _impl->first_index];
+        commit_patch patch;
+        patch.message = message;
+        patch.name = delta.name;
+        patch.ppq = delta.ppq;
+        patch.master_track_id = delta.master_track_id;
+        copy_writes(delta.mixer_tracks, patch.mixer_tracks);
+        copy_writes(delta.audio_sequencers, patch.audio_sequencers);
+        copy_writes(delta.midi_sequencers, patch.midi_sequencers);
+        return patch;
+    }
+
+    const symbol_table& project_history::get_symbols() const
+    {
+        return _impl->symbols;
+    }
+
+    void project_history::commit(const std::size_t index, const fmtdxc::project& proj, const entity_changes& changes, const std::chrono::system_clock::time_point time)
+    {
+        if (index <= get_first_index() || index > get_last_index() + 1) {
+            throw std::invalid_argument("Index provided to project history commit does not follow a known state");
+        }
+        _impl->drop_after(index - 1);
+        assign_changes(proj, changes, _impl->symbols, _impl->last);
+        _impl->push_delta(index, changes, time);
+    }
+
+    void project_history::commit(const std::size_t index, const working_project& proj, const entity_changes& changes, const std::chrono::system_clock::time_point time)
+    {
+        if (index <= get_first_index() || index > get_last_index() + 1) {
+            throw std::invalid_argument("Index provided to project history commit does not follow a known state");
+        }
+        if (proj._impl->history != _impl) {
+            throw std::invalid_argument("Working project provided to project history commit was checked out of another history");
+        }
+        _impl->drop_after(index - 1);
+        const shared_project& written = proj._impl->state;
+        _impl->last.name = written.name;
+        _impl->last.ppq = written.ppq;
+        _impl->last.master_track_id = written.master_track_id;
+        adopt_entities(written.mixer_tracks, changes.mixer_tracks, _impl->last.mixer_tracks);
+        adopt_entities(written.audio_sequencers, changes.audio_sequencers, _impl->last.audio_sequencers);
+        adopt_entities(written.midi_sequencers, changes.midi_sequencers, _impl->last.midi_sequencers);
+        _impl->push_delta(index, changes, time);
+    }
+
+    void project_history::prepend(const fmtdxc::project& proj)
+    {
+        if (!_impl->first_index) {
+            throw std::invalid_argument("Project provided to project history prepend comes before the first commit");
+        }
+
+        // Walking down from a loaded container is rare, every entity is hashed to find what the next commit wrote
+        const shared_project& next = _impl->checkpoints.at(_impl->first_index);
+        project_hashes hashes;
+        project_hashes nextHashes;
+        hash_project(proj, hashes);
+        hash_project(materialize(next, _impl->symbols), nextHashes);
+        const entity_changes changes = get_changed_entities(hashes, nextHashes);
+        shared_project earlier = next;
+        assign_changes(proj, changes, _impl->symbols, earlier);
+        _impl->deltas.push_front(make_delta(next, changes, std::chrono::system_clock::time_point()));
+
+        // The old first state stays a checkpoint only where the interval puts one
+        if (_impl->first_index % _impl->checkpoint_interval != 0) {
+            _impl->checkpoints.erase(_impl->first_index);
+        }
+        _impl->first_index--;
+        _impl->checkpoints.emplace(_impl->first_index, std::move(earlier));
+    }
+
+    working_project::working_project(const project_history& history, const std::size_t index)
+    {
+        if (!history.contains(index)) {
+            throw std::invalid_argument("Index provided to working project is out of the history");
+        }
+        _impl = std::make_shared<working_project_impl>();
+        _impl->history = history._impl;
+        _impl->state = history._impl->build(index);
+    }
+
+    bool working_project::has_mixer_track(const std::uint32_t id) const
+    {
+        return _impl->state.mixer_tracks.count(id) != 0;
+    }
+
+    bool working_project::has_audio_sequencer(const std::uint32_t id) const
+    {
+        return _impl->state.audio_sequencers.count(id) != 0;
+    }
+
+    bool working_project::has_midi_sequencer(const std::uint32_t id) const
+    {
+        return _impl->state.midi_sequencers.count(id) != 0;
+    }
+
+    void working_project::set_header(const std::string& name, const decltype(fmtdxc::project::ppq) ppq, const decltype(fmtdxc::project::master_track_id) master_track_id)
+    {
+        _impl->state.name = _impl->history->symbols.intern(name);
+        _impl->state.ppq = ppq;
+        _impl->state.master_track_id = master_track_id;
+    }
+
+    void working_project::write(const std::uint32_t id, const fmtdxc::project::mixer_track& mt)
+    {
+        _impl->state.mixer_tracks.insert_or_assign(id, make_node(mt, nullptr, _impl->history->symbols, _impl->compare));
+    }
+
+    void working_project::write(const std::uint32_t id, const fmtdxc::project::audio_sequencer& as)
+    {
+        auto& nodes = _impl->state.audio_sequencers;
+        const auto previous = nodes.find(id);
+        audio_sequencer_node node = make_node(as, previous != nodes.end() ? &previous->second : nullptr, _impl->history->symbols, _impl->compare);
+        nodes.insert_or_assign(id, std::move(node));
+    }
+
+    void working_project::write(const std::uint32_t id, const fmtdxc::project::midi_sequencer& ms)
+    {
+        _impl->state.midi_sequencers.insert_or_assign(id, make_node(ms, nullptr, _impl->history->symbols, _impl->compare));
+    }
+
+    bool working_project::erase_mixer_track(const std::uint32_t id)
+    {
+        return erase_node(id, _impl->state.mixer_tracks);
+    }
+
+    bool working_project::erase_audio_sequencer(const std::uint32_t id)
+    {
+        return erase_node(id, _impl->state.audio_sequencers);
+    }
+
+    bool working_project::erase_midi_sequencer(const std::uint32_t id)
+    {
+        return erase_node(id, _impl->state.midi_sequencers);
+    }
+
+    void working_project::assign(const fmtdxc::project& proj, const entity_changes& changes)
+    {
+        assign_changes(proj, changes, _impl->history->symbols, _impl->state);
+    }
+
+    fmtdxc::project working_project::materialize() const
+    {
+        return rtdxc::detail::materialize(_impl->state, _impl->history->symbols);
+    }
+
+    fmtdxc::project working_project::materialize(const entity_changes& changes) const
+    {
+        const symbol_table& symbols = _impl->history->symbols;
+        fmtdxc::project proj;
+        proj.name = symbols.get_text(_impl->state.name);
+        proj.ppq = _impl->state.ppq;
+        proj.master_track_id = _impl->state.master_track_id;
+        materialize_entities(_impl->state.mixer_tracks, changes.mixer_tracks, symbols, proj.mixer_tracks);
+        materialize_entities(_impl->state.audio_sequencers, changes.audio_sequencers, symbols, proj.audio_sequencers);
+        materialize_entities(_impl->state.midi_sequencers, changes.midi_sequencers, symbols, proj.midi_sequencers);
+        return proj;
+    }
+
+}
+}
@@ -0,0 +1,188 @@
+#include <rtdxc/rtdxc.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+
+namespace rtdxc {
+namespace {
+
+    // A job holds the decoded XML, the ALS tree parsed from it and the project converted from that tree at once
+    constexpr std::uintmax_t resident_bytes_per_decoded_byte = 3;
+
+    // Admits jobs while their estimated resident bytes fit the budget, a set larger than the whole budget waits to run alone
+    struct byte_budget {
+        explicit byte_budget(const std::uintmax_t capacity)
+            : _capacity(capacity ? capacity : 1)
+        {
+        }
+
+        void acquire(const std::uintmax_t bytes)
+        {
+            std::unique_lock<std::mutex> _lock(_mutex);
+            _released.wait(_lock, [&]() {
+                return _in_flight == 0 || _in_flight + bytes <= _capacity;
+            });
+            _in_flight += bytes;
+        }
+
+        void release(const std::uintmax_t bytes)
+        {
+            {
+                std::lock_guard<std::mutex> _lock(_mutex);
+                _in_flight -= bytes;
+            }
+            _released.notify_all();
+        }
+
+    private:
+        const std::uintmax_t _capacity;
+        std::uintmax_t _in_flight = 0;
+        std::mutex _mutex;
+        std::condition_variable _released;
+    };
+
+    // Decoded size of an ALS set from the ISIZE trailer of its gzip stream, sets saved uncompressed are their own size.
+    // ISIZE only keeps the size modulo 4 GiB, the file size is the floor
+    [[nodiscard]] std::uintmax_t get_decoded_size(const std::filesystem::path& als_path, const std::uintmax_t file_size)
+    {
+        std::ifstream _als_stream(als_path, std::ios::binary);
+        unsigned char _magic[2] = {};
+        if (file_size < 18 || !_als_stream.read(reinterpret_cast<char*>(_magic), sizeof(_magic)) || _magic[0] != 0x1f || _magic[1] != 0x8b) {
+            return file_size;
+        }
+        unsigned char _trailer[4] = {};
+        _als_stream.seekg(-static_cast<std::streamoff>(sizeof(_trailer)), std::ios::end);
+        if (!_als_stream.read(reinterpret_cast<char*>(_trailer), sizeof(_trailer))) {
+            return file_size;
+        }
+        const std::uintmax_t _isize = static_cast<std::uintmax_t>(_trailer[0])
+            | static_cast<std::uintmax_t>(_trailer[1]) << 8
+            | static_cast<std::uintmax_t>(_trailer[2]) << 16
+            | static_cast<std::uintmax_t>(_trailer[3]) << 24;
+        return std::max(_isize, file_size);
+    }
+
+    // Names are picked up front so that jobs never race for the same file
+    [[nodiscard]] std::vector<std::filesystem::path> make_dxcc_paths(const std::vector<std::filesystem::path>& als_paths, const std::filesystem::path& collection_directory_path)
+    {
+        std::vector<std::filesystem::path> _dxcc_paths;
+        _dxcc_paths.reserve(als_paths.size());
+        std::unordered_set<std::string> _taken_names;
+        for (const std::filesystem::path& _als_path : als_paths) {
+            const std::string _stem = _als_path.stem().string();
+            std::filesystem::path _dxcc_path = collection_directory_path / (_stem + ".dxcc");
+            for (std::size_t _suffix = 2; _taken_names.count(_dxcc_path.filename().string()) || std::filesystem::exists(_dxcc_path); _suffix++) {
+                _dxcc_path = collection_directory_path / (_stem + " (" + std::to_string(_suffix) + ").dxcc");
+            }
+            _taken_names.insert(_dxcc_path.filename().string());
+            _dxcc_paths.push_back(_dxcc_path);
+        }
+        return _dxcc_paths;
+    }
+
+    void import_one(import_result& result)
+    {
+        fmtals::project _als_project;
+        {
+            std::ifstream _als_stream(result.als_path, std::ios::binary);
+            if (!_als_stream) {
+                throw std::runtime_error("Failed to open ALS set for import");
+            }
+            fmtals::version _als_version;
+            fmtals::import_project(_als_stream, _als_project, _als_version);
+        }
+
+        // Jobs already run side by side, each set converts on its own thread
+        const fmtdxc::project_container _container(detail::convert_from_als(std::move(_als_project)));
+
+        std::ofstream _dxcc_stream(result.dxcc_path, std::ios::binary);
+        if (!_dxcc_stream) {
+            throw std::runtime_error("Failed to create dxcc container in collection directory");
+        }
+        fmtdxc::export_container(_dxcc_stream, _container, fmtdxc::version::alpha);
+    }
+
+}
+
+std::vector<std::filesystem::path> find_als_sets(const std::filesystem::path& directory_path)
+{
+    if (!std::filesystem::is_directory(directory_path)) {
+        throw std::invalid_argument("Directory provided to find ALS sets does not exist");
+    }
+
+    std::vector<std::filesystem::path> _als_paths;
+    for (const std::filesystem::directory_entry& _entry : std::filesystem::recursive_directory_iterator(directory_path)) {
+        const std::filesystem::path _relative_path = std::filesystem::relative(_entry.path(), directory_path);
+        const bool _is_backup = std::any_of(_relative_path.begin(), _relative_path.end(), [](const std::filesystem::path& _part) {
+            return _part == "Backup";
+        });
+        if (_entry.is_regular_file() && _entry.path().extension() == ".als" && !_is_backup) {
+            _als_paths.push_back(_entry.path());
+        }
+    }
+    std::sort(_als_paths.begin(), _als_paths.end());
+    return _als_paths;
+}
+
+std::vector<import_result> import_many(
+    const std::vector<std::filesystem::path>& als_paths,
+    const std::filesystem::path& collection_directory_path,
+    const import_options& options)
+{
+    if (!std::filesystem::is_directory(collection_directory_path)) {
+        throw std::invalid_argument("Collection directory provided to import does not exist");
+    }
+
+    std::vector<import_result> _results(als_paths.size());
+    const std::vector<std::filesystem::path> _dxcc_paths = make_dxcc_paths(als_paths, collection_directory_path);
+    for (std::size_t _index = 0; _index < als_paths.size(); _index++) {
+        _results[_index].als_path = als_paths[_index];
+        _results[_index].dxcc_path = _dxcc_paths[_index];
+    }
+
+    const std::size_t _hardware_count = std::max(1u, std::thread::hardware_concurrency());
+    const std::size_t _job_count = std::min(options.job_count ? options.job_count : _hardware_count, std::max<std::size_t>(1, als_paths.size()));
+    byte_budget _budget(options.max_bytes_in_flight);
+    std::atomic<std::size_t> _next_index { 0 };
+
+    const auto _run_jobs = [&]() {
+        for (std::size_t _index = _next_index++; _index < _results.size(); _index = _next_index++) {
+            import_result& _result = _results[_index];
+            std::error_code _error_code;
+            const std::uintmax_t _file_size = std::filesystem::file_size(_result.als_path, _error_code);
+            _result.als_bytes = _error_code ? 0 : _file_size;
+            const std::uintmax_t _resident_bytes = get_decoded_size(_result.als_path, _result.als_bytes) * resident_bytes_per_decoded_byte;
+
+            _budget.acquire(_resident_bytes);
+            try {
+                import_one(_result);
+            } catch (const std::exception& _exception) {
+                _result.error = _exception.what();
+                std::filesystem::remove(_result.dxcc_path, _error_code);
+            }
+            _budget.release(_resident_bytes);
+
+            if (options.progress_callback) {
+                options.progress_callback(_result);
+            }
+        }
+    };
+
+    std::vector<std::thread> _jobs;
+    _jobs.reserve(_job_count - 1);
+    for (std::size_t _job_index = 1; _job_index < _job_count; _job_index++) {
+        _jobs.emplace_back(_run_jobs);
+    }
+    _run_jobs();
+    for (std::thread& _job : _jobs) {
+        _job.join();
+    }
+    return _results;
+}
+
+}
@@ -0,0 +1,999 @@
+#include <rtdxc/rtdxc.hpp>
+
+#include <enet/enet.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <thread>
+
+namespace rtdxc {
+namespace detail {
+
+    namespace {
+
+        static constexpr std::size_t channel_count = 1;
+        static constexpr std::size_t host_peer_count = 64; // per endpoint the host listens on
+        static constexpr std::size_t received_queue_capacity = 4096; // events, past it the network thread keeps them until the dispatch thread catches up
+        static constexpr enet_uint32 service_timeout_ms = 1; // longest a send waits for the network thread, ENet has no way to wake a service
+        static constexpr enet_uint32 connect_timeout_ms = 5000;
+        static constexpr std::size_t range_coder_max_size = 1024; // payloads below it go through the range coder, the LZ block codec finds too little to match in them
+
+        // First byte of every packet, the payload follows as is or after its size and the compressed bytes
+        enum struct frame_codec : std::uint8_t {
+            none = 0,
+            range_coder = 1,
+            lz_block = 2,
+            hello = 0xff, // not a codec, the mask of the codecs its sender decodes follows
+        };
+
+        constexpr std::uint8_t codec_bit(const frame_codec codec)
+        {
+            return static_cast<std::uint8_t>(1u << static_cast<std::uint8_t>(codec));
+        }
+
+        static constexpr std::uint8_t decoded_codecs = codec_bit(frame_codec::none) | codec_bit(frame_codec::range_coder) | codec_bit(frame_codec::lz_block);
+        static constexpr std::uint8_t uncompressed_codecs = codec_bit(frame_codec::none); // of a peer that didn't say hello yet
+        static constexpr std::size_t frame_header_size = 5; // codec and payload size
+
+        struct enet_lib {
+            enet_lib() { enet_initialize(); }
+            ~enet_lib() { enet_deinitialize(); }
+        };
+
+        struct packet_deleter {
+            void operator()(ENetPacket* packet) const
+            {
+                enet_packet_destroy(packet);
+            }
+        };
+
+        using packet_ptr = std::unique_ptr<ENetPacket, packet_deleter>;
+
+        // One producer and one consumer, each index is only written by its own side so that neither ever waits on the other
+        template <typename value_t>
+        struct spsc_queue {
+            explicit spsc_queue(const std::size_t capacity) // a power of two
+                : slots(capacity)
+            {
+            }
+
+            // value is left as it was when the queue is full
+            [[nodiscard]] bool try_push(value_t& value)
+            {
+                const std::size_t tail = tail_index.load(std::memory_order_relaxed);
+                if (tail - cached_head == slots.size()) {
+                    cached_head = head_index.load(std::memory_order_acquire);
+                    if (tail - cached_head == slots.size()) {
+                        return false;
+                    }
+                }
+                slots[tail & (slots.size() - 1)] = std::move(value);
+                tail_index.store(tail + 1, std::memory_order_release);
+                return true;
+            }
+
+            [[nodiscard]] bool try_pop(value_t& value)
+            {
+                const std::size_t head = head_index.load(std::memory_order_relaxed);
+                if (head == cached_tail) {
+                    cached_tail = tail_index.load(std::memory_order_acquire);
+                    if (head == cached_tail) {
+                        return false;
+                    }
+                }
+                value = std::move(slots[head & (slots.size() - 1)]);
+                head_index.store(head + 1, std::memory_order_release);
+                return true;
+            }
+
+            [[nodiscard]] bool is_empty() const // from the consumer
+            {
+                return head_index.load(std::memory_order_relaxed) == tail_index.load(std::memory_order_acquire);
+            }
+
+            std::vector<value_t> slots;
+            alignas(64) std::atomic<std::size_t> head_index { 0 };
+            std::size_t cached_tail = 0; // consumer side
+            alignas(64) std::atomic<std::size_t> tail_index { 0 };
+            std::size_t cached_head = 0; // producer side
+        };
+
+        // Any number of producers and one consumer, a push is one exchange. a push caught between its exchange and
+        // its link hides itself and the ones after it from the consumer until it links
+        template <typename value_t>
+        struct mpsc_queue {
+            struct node {
+                std::atomic<node*> next { nullptr };
+                value_t value;
+            };
+
+            mpsc_queue()
+                : head(new node)
+                , tail(head.load(std::memory_order_relaxed))
+            {
+            }
+
+            mpsc_queue(const mpsc_queue& other) = delete;
+            mpsc_queue& operator=(const mpsc_queue& other) = delete;
+
+            ~mpsc_queue()
+            {
+                value_t value;
+                while (try_pop(value)) { }
+                delete tail;
+            }
+
+            void push(value_t&& value)
+            {
+                node* const pushed = new node;
+                pushed->value = std::move(value);
+                node* const previous = head.exchange(pushed, std::memory_order_acq_rel);
+                previous->next.store(pushed, std::memory_order_release);
+            }
+
+            [[nodiscard]] bool try_pop(value_t& value)
+            {
+                node* const next = tail->next.load(std::memory_order_acquire);
+                if (!next) {
+                    return false;
+                }
+                value = std::move(next->value);
+                delete tail;
+                tail = next; // the popped node stays as the one before the next
+                return true;
+            }
+
+            std::atomic<node*> head;
+            node* tail; // consumer side
+        };
+
+        // Lets the consumer of a lock-free queue sleep, the producer only takes the mutex when the consumer is asleep
+        struct wake_signal {
+            void notify()
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst); // orders what was pushed before reading is_waiting
+                if (is_waiting.load(std::memory_order_relaxed)) {
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        is_notified = true;
+                    }
+                    condition.notify_one();
+                }
+            }
+
+            template <typename predicate_t>
+            void wait(const predicate_t& is_ready)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                is_waiting.store(true, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst); // orders is_waiting before reading what was pushed
+                condition.wait(lock, [&] { return is_notified || is_ready(); });
+                is_notified = false;
+                is_waiting.store(false, std::memory_order_relaxed);
+            }
+
+            std::mutex mutex;
+            std::condition_variable condition;
+            std::atomic<bool> is_waiting { false };
+            bool is_notified = false;
+        };
+
+        // Set from any thread, read by the dispatch thread for each event without holding the lock while calling
+        template <typename callback_t>
+        struct callback_slot {
+            void set(const callback_t& callback)
+            {
+                std::shared_ptr<const callback_t> stored = callback ? std::make_shared<const callback_t>(callback) : nullptr;
+                std::lock_guard<std::mutex> lock(mutex);
+                current = std::move(stored);
+            }
+
+            [[nodiscard]] std::shared_ptr<const callback_t> get() const
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                return current;
+            }
+
+            mutable std::mutex mutex;
+            std::shared_ptr<const callback_t> current;
+        };
+
+        enum struct transport_event_type {
+            connect,
+            rebind,
+            disconnect,
+            receive,
+        };
+
+        struct transport_event {
+            transport_event_type type = transport_event_type::receive;
+            p2p_client_id id = 0;
+            std::vector<std::uint8_t> payload;
+            p2p_peer_info info {};
+        };
+
+        enum struct transport_command_type {
+            send,
+            broadcast,
+            disconnect,
+            listen,
+        };
+
+        struct transport_command {
+            transport_command_type type = transport_command_type::send;
+            p2p_client_id id = 0;
+            packet_ptr packet;
+            std::size_t payload_size = 0;
+            std::chrono::steady_clock::duration compression_time {};
+            ENetHost* host = nullptr; // to listen on, the network thread owns it from then on
+        };
+
+        // Session threads push commands, the network thread pushes events and the dispatch thread calls back with them
+        struct transport_queues {
+            // From the network thread, never waits. events the dispatch thread has no room for yet wait in the backlog
+            void push_event(transport_event&& event)
+            {
+                if (backlog.empty() && events.try_push(event)) {
+                    is_event_pushed = true;
+                    return;
+                }
+                backlog.push_back(std::move(event));
+            }
+
+            // From the network thread once per loop, wakes the dispatch thread if it sleeps
+            void publish_events()
+            {
+                while (!backlog.empty() && events.try_push(backlog.front())) {
+                    backlog.pop_front();
+                    is_event_pushed = true;
+                }
+                if (is_event_pushed) {
+                    is_event_pushed = false;
+                    event_signal.notify();
+                }
+            }
+
+            // Runs the dispatch thread, the events left when the transport stops are dropped
+            template <typename handler_t>
+            void dispatch_events(const handler_t& handler)
+            {
+                transport_event event;
+                while (is_running.load(std::memory_order_acquire)) {
+                    while (events.try_pop(event)) {
+                        try {
+                            handler(event);
+                        } catch (const std::exception& exception) {
+                            std::cerr << "P2P callback failed: " << exception.what() << std::endl;
+                        }
+                    }
+                    event_signal.wait([this] { return !is_running.load(std::memory_order_relaxed) || !events.is_empty(); });
+                }
+            }
+
+            void stop()
+            {
+                is_running.store(false, std::memory_order_relaxed);
+                event_signal.notify();
+            }
+
+            std::atomic<bool> is_running { true };
+            mpsc_queue<transport_command> commands;
+            spsc_queue<transport_event> events { received_queue_capacity };
+            std::deque<transport_event> backlog; // network thread only
+            bool is_event_pushed = false; // network thread only
+            wake_signal event_signal;
+        };
+
+        [[nodiscard]] p2p_peer_info make_peer_info(const ENetPeer* peer)
+        {
+            char ip[64] = {};
+            enet_address_get_host_ip(&peer->address, ip, sizeof(ip));
+            return { ip, peer->address.port, std::chrono::steady_clock::now(), 0, 0 };
+        }
+
+        [[nodiscard]] packet_ptr make_packet(const std::uint8_t* data, const std::size_t size)
+        {
+            packet_ptr packet(enet_packet_create(data, size, ENET_PACKET_FLAG_RELIABLE));
+            if (!packet) {
+                throw std::runtime_error("Failed to allocate an ENet packet of " + std::to_string(size) + " bytes");
+            }
+            return packet;
+        }
+
+        // A rebound peer keeps counting from where its previous address stopped
+        void keep_counters(const p2p_peer_info& previous, p2p_peer_info& info)
+        {
+            info.received_bytes = previous.received_bytes;
+            info.sent_bytes = previous.sent_bytes;
+            info.received_payload_bytes = previous.received_payload_bytes;
+            info.sent_payload_bytes = previous.sent_payload_bytes;
+            info.compression_time = previous.compression_time;
+            info.decompression_time = previous.decompression_time;
+        }
+
+        [[nodiscard]] packet_ptr make_hello()
+        {
+            const std::uint8_t hello[] = { static_cast<std::uint8_t>(frame_codec::hello), decoded_codecs };
+            return make_packet(hello, sizeof(hello));
+        }
+
+        // ENet's range coder keeps its model in a context that can't be shared between threads
+        struct range_coder {
+            range_coder()
+                : context(enet_range_coder_create())
+            {
+                if (!context) {
+                    throw std::bad_alloc();
+                }
+            }
+
+            ~range_coder()
+            {
+                enet_range_coder_destroy(context);
+            }
+
+            void* context;
+        };
+
+        [[nodiscard]] range_coder& get_range_coder()
+        {
+            thread_local range_coder coder;
+            return coder;
+        }
+
+        [[nodiscard]] bool compress_frame(const std::vector<std::uint8_t>& payload, const frame_codec codec, std::vector<std::uint8_t>& frame)
+        {
+            const std::uint32_t size = static_cast<std::uint32_t>(payload.size());
+            frame.push_back(static_cast<std::uint8_t>(codec));
+            for (std::size_t shift = 0; shift < 32; shift += 8) {
+                frame.push_back(static_cast<std::uint8_t>(size >> shift));
+            }
+            if (codec == frame_codec::lz_block) {
+                compress_block(payload.data(), payload.size(), frame);
+                return frame.size() <= payload.size();
+            }
+            ENetBuffer buffer;
+            buffer.data = const_cast<std::uint8_t*>(payload.data());
+            buffer.dataLength = payload.size();
+            frame.resize(frame_header_size + payload.size());
+            const std::size_t compressedSize = enet_range_coder_compress(get_range_coder().context, &buffer, 1, payload.size(), frame.data() + frame_header_size, payload.size() - frame_header_size);
+            frame.resize(frame_header_size + compressedSize);
+            return compressedSize > 0;
+        }
+
+        // Payloads the codecs can't shrink, or that the peer can't decode, go out as they are after a none byte
+        void set_frame(const std::vector<std::uint8_t>& payload, const std::uint8_t codecs, transport_command& command)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            const frame_codec codec = payload.size() < range_coder_max_size ? frame_codec::range_coder : frame_codec::lz_block;
+            command.payload_size = payload.size();
+            std::vector<std::uint8_t> frame;
+            if (payload.size() > frame_header_size && (codecs & codec_bit(codec))) {
+                frame.reserve(payload.size() + 1);
+                if (!compress_frame(payload, codec, frame)) {
+                    frame.clear();
+                }
+            }
+            if (frame.empty()) {
+                frame.reserve(payload.size() + 1);
+                frame.push_back(static_cast<std::uint8_t>(frame_codec::none));
+                frame.insert(frame.end(), payload.begin(), payload.end());
+            }
+            command.packet = make_packet(frame.data(), frame.size());
+            command.compression_time = std::chrono::steady_clock::now() - start;
+        }
+
+        // From the network thread, malformed frames and codecs it doesn't decode leave payload empty and return false
+        [[nodiscard]] bool read_frame(const ENetPacket* packet, std::vector<std::uint8_t>& payload)
+        {
+            if (!packet->dataLength) {
+                return false;
+            }
+            const frame_codec codec = static_cast<frame_codec>(packet->data[0]);
+            if (codec == frame_codec::none) {
+                payload.assign(packet->data + 1, packet->data + packet->dataLength);
+                return true;
+            }
+            if (packet->dataLength < frame_header_size || !(decoded_codecs & codec_bit(codec))) {
+                return false;
+            }
+            std::size_t size = 0;
+            for (std::size_t index = 0; index < 4; ++index) {
+                size |= static_cast<std::size_t>(packet->data[1 + index]) << (8 * index);
+            }
+            const std::uint8_t* compressed = packet->data + frame_header_size;
+            const std::size_t compressedSize = packet->dataLength - frame_header_size;
+            if (codec == frame_codec::range_coder ? size >= range_coder_max_size : size / 256 > compressedSize) {
+                return false; // more than the sender could have compressed, the frame is not allocated for
+            }
+            if (codec == frame_codec::lz_block) {
+                try {
+                    decompress_block(compressed, compressedSize, size, payload);
+                } catch (const std::invalid_argument&) {
+                    payload.clear();
+                    return false;
+                }
+                return true;
+            }
+            payload.resize(size);
+            if (enet_range_coder_decompress(get_range_coder().context, compressed, compressedSize, payload.data(), size) != size) {
+                payload.clear();
+                return false;
+            }
+            return true;
+        }
+
+        [[nodiscard]] bool is_hello(const ENetPacket* packet)
+        {
+            return packet->dataLength == 2 && packet->data[0] == static_cast<std::uint8_t>(frame_codec::hello);
+        }
+
+        [[nodiscard]] std::uint8_t read_hello(const ENetPacket* packet)
+        {
+            return (packet->data[1] & decoded_codecs) | uncompressed_codecs;
+        }
+
+        // Sleeps until one of the sockets has something to read or the timeout passes
+        void wait_sockets(ENetHost* const* hosts, const std::size_t host_count, const enet_uint32 timeout_ms)
+        {
+            ENetSocketSet sockets;
+            ENET_SOCKETSET_EMPTY(sockets);
+            ENetSocket maxSocket = 0;
+            for (std::size_t index = 0; index < host_count; index++) {
+                ENET_SOCKETSET_ADD(sockets, hosts[index]->socket);
+                maxSocket = std::max(maxSocket, hosts[index]->socket);
+            }
+            enet_socketset_select(maxSocket, &sockets, nullptr, timeout_ms);
+        }
+
+        [[nodiscard]] p2p_client_id make_client_id()
+        {
+            std::random_device device;
+            return std::uniform_int_distribution<p2p_client_id>(1)(device);
+        }
+
+        [[nodiscard]] ENetHost* create_listening_host(const std::string& ipv4, const std::uint16_t port)
+        {
+            ENetAddress address;
+            if (enet_address_set_host_ip(&address, ipv4.c_str())) {
+                throw std::invalid_argument("IPv4 provided to p2p host is not a valid address");
+            }
+            address.port = port;
+            ENetHost* host = enet_host_create(&address, host_peer_count, channel_count, 0, 0);
+            if (!host) {
+                throw std::runtime_error("Failed to listen on " + ipv4 + ":" + std::to_string(port));
+            }
+            return host;
+        }
+
+    }
+
+    // Clients name themselves with the id they connect with, so that reconnecting from another address is a rebind
+    struct host_session_impl {
+        host_session_impl(const std::string& ipv4, const std::uint16_t port)
+            : hosts({ create_listening_host(ipv4, port) })
+            , port(hosts.front()->address.port)
+            , network([this] { run_network(); })
+            , dispatch([this] { run_dispatch(); })
+        {
+        }
+
+        ~host_session_impl()
+        {
+            is_network_running.store(false, std::memory_order_relaxed);
+            network.join();
+            queues.stop();
+            dispatch.join();
+            for (ENetHost* host : hosts) {
+                enet_host_destroy(host);
+            }
+        }
+
+        void run_network()
+        {
+            ENetEvent event;
+            while (is_network_running.load(std::memory_order_relaxed)) {
+                bool isBusy = run_commands();
+                for (ENetHost* host : hosts) {
+                    while (enet_host_service(host, &event, 0) > 0) {
+                        handle_event(event);
+                        isBusy = true;
+                    }
+                }
+                queues.publish_events();
+                publish_infos();
+                if (!isBusy) {
+                    wait_sockets(hosts.data(), hosts.size(), service_timeout_ms);
+                }
+            }
+            for (const auto& [id, peer] : peers) {
+                enet_peer_disconnect_now(peer, 0);
+            }
+            for (ENetHost* host : hosts) {
+                enet_host_flush(host);
+            }
+        }
+
+        [[nodiscard]] bool run_commands()
+        {
+            bool isRun = false;
+            transport_command command;
+            while (queues.commands.try_pop(command)) {
+                isRun = true;
+                if (command.type == transport_command_type::listen) {
+                    hosts.push_back(command.host);
+                } else if (command.type == transport_command_type::broadcast) {
+                    for (const auto& [id, peer] : peers) {
+                        send_packet(id, peer, command);
+                    }
+                } else {
+                    const auto peer = peers.find(command.id);
+                    if (peer == peers.end()) {
+                        continue; // disconnected meanwhile, ENet would drop it as well
+                    }
+                    if (command.type == transport_command_type::send) {
+                        send_packet(command.id, peer->second, command);
+                    } else {
+                        enet_peer_disconnect(peer->second, 0);
+                    }
+                }
+                if (command.packet && command.packet->referenceCount) {
+                    command.packet.release(); // the peers it was queued on own it now
+                }
+            }
+            return isRun;
+        }
+
+        // Framed on the sender's thread with the codecs every peer decoded then, a peer that connected since gets it uncompressed
+        void send_packet(const p2p_client_id id, ENetPeer* peer, const transport_command& command)
+        {
+            ENetPacket* packet = command.packet.get();
+            packet_ptr uncompressed;
+            const auto peerCodecs = peer_codecs.find(id);
+            if (!((peerCodecs == peer_codecs.end() ? uncompressed_codecs : peerCodecs->second) & codec_bit(static_cast<frame_codec>(packet->data[0])))) {
+                std::vector<std::uint8_t> payload;
+                if (!read_frame(packet, payload)) {
+                    return;
+                }
+                transport_command reframed;
+                set_frame(payload, uncompressed_codecs, reframed);
+                uncompressed = std::move(reframed.packet);
+                packet = uncompressed.get();
+            }
+            if (!enet_peer_send(peer, 0, packet)) {
+                p2p_peer_info& info = infos[id];
+                info.sent_bytes += packet->dataLength;
+                info.sent_payload_bytes += command.payload_size;
+                info.compression_time += command.compression_time;
+                is_info_changed = true;
+                uncompressed.release();
+            }
+        }
+
+        // Every peer decodes what is compressed for all of them, sends pick their codec from it without waiting on the network thread
+        void update_codecs()
+        {
+            std::uint8_t common = decoded_codecs;
+            for (const auto& [id, peer] : peers) {
+                const auto peerCodecs = peer_codecs.find(id);
+                common &= peerCodecs == peer_codecs.end() ? uncompressed_codecs : peerCodecs->second;
+            }
+            codecs.store(common, std::memory_order_relaxed);
+        }
+
+        void handle_event(const ENetEvent& event)
+        {
+            const p2p_client_id id = static_cast<p2p_client_id>(reinterpret_cast<std::uintptr_t>(event.peer->data));
+            if (event.type == ENET_EVENT_TYPE_CONNECT) {
+                if (!event.data) {
+                    enet_peer_disconnect_now(event.peer, 0); // not a p2p_client
+                    return;
+                }
+                transport_event connected { transport_event_type::connect, event.data, {}, make_peer_info(event.peer) };
+                ENetPeer*& current = peers[event.data];
+                if (current) {
+                    current->data = nullptr;
+                    enet_peer_reset(current); // the address it had is gone
+                    connected.type = transport_event_type::rebind;
+                    keep_counters(infos[event.data], connected.info);
+                } else {
+                    peer_codecs.erase(event.data); // until its hello
+                }
+                current = event.peer;
+                event.peer->data = reinterpret_cast<void*>(static_cast<std::uintptr_t>(event.data));
+                infos[event.data] = connected.info;
+                is_info_changed = true;
+                packet_ptr hello = make_hello();
+                if (!enet_peer_send(event.peer, 0, hello.get())) {
+                    hello.release();
+                }
+                update_codecs();
+                queues.push_event(std::move(connected));
+            } else if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+                packet_ptr packet(event.packet);
+                if (!id) {
+                    return;
+                }
+                p2p_peer_info& info = infos[id];
+                info.received_bytes += packet->dataLength;
+                info.last_seen = std::chrono::steady_clock::now();
+                is_info_changed = true;
+                if (is_hello(packet.get())) {
+                    peer_codecs[id] = read_hello(packet.get());
+                    update_codecs();
+                    return;
+                }
+                const auto start = std::chrono::steady_clock::now();
+                std::vector<std::uint8_t> payload;
+                if (!read_frame(packet.get(), payload)) {
+                    return;
+                }
+                info.received_payload_bytes += payload.size();
+                info.decompression_time += std::chrono::steady_clock::now() - start;
+                queues.push_event({ transport_event_type::receive, id, std::move(payload), {} });
+            } else if (event.type == ENET_EVENT_TYPE_DISCONNECT && id) {
+                event.peer->data = nullptr;
+                peers.erase(id);
+                infos.erase(id);
+                peer_codecs.erase(id);
+                update_codecs();
+                is_info_changed = true;
+                queues.push_event({ transport_event_type::disconnect, id, {}, {} });
+            }
+        }
+
+        // Readers only ever hold the lock to copy, the network thread tries again next loop when they do
+        void publish_infos()
+        {
+            if (!is_info_changed) {
+                return;
+            }
+            std::unique_lock<std::mutex> lock(published_infos_mutex, std::try_to_lock);
+            if (lock.owns_lock()) {
+                published_infos = infos;
+                is_info_changed = false;
+            }
+        }
+
+        void run_dispatch()
+        {
+            queues.dispatch_events([this](transport_event& event) {
+                if (event.type == transport_event_type::receive) {
+                    if (const auto callback = receive_callback.get()) {
+                        (*callback)(event.id, event.payload);
+                    }
+                } else if (event.type == transport_event_type::connect) {
+                    if (const auto callback = connect_callback.get()) {
+                        (*callback)(event.id);
+                    }
+                } else if (event.type == transport_event_type::rebind) {
+                    if (const auto callback = rebind_callback.get()) {
+                        (*callback)(event.id, event.info);
+                    }
+                } else if (const auto callback = disconnect_callback.get()) {
+                    (*callback)(event.id);
+                }
+            });
+        }
+
+        enet_lib lib;
+        std::vector<ENetHost*> hosts; // network thread only once it runs
+        std::uint16_t port;
+        std::unordered_map<p2p_client_id, ENetPeer*> peers; // network thread only
+        std::unordered_map<p2p_client_id, p2p_peer_info> infos; // network thread only
+        std::unordered_map<p2p_client_id, std::uint8_t> peer_codecs; // network thread only, from the hello of each peer
+        bool is_info_changed = false; // network thread only
+        std::atomic<std::uint8_t> codecs { decoded_codecs }; // decoded by every peer
+        std::mutex published_infos_mutex;
+        std::unordered_map<p2p_client_id, p2p_peer_info> published_infos;
+        callback_slot<std::function<void(p2p_client_id)>> connect_callback;
+        callback_slot<std::function<void(p2p_client_id, const p2p_peer_info&)>> rebind_callback;
+        callback_slot<std::function<void(p2p_client_id)>> disconnect_callback;
+        callback_slot<std::function<void(p2p_client_id, const std::vector<std::uint8_t>&)>> receive_callback;
+        transport_queues queues;
+        std::atomic<bool> is_network_running { true };
+        std::thread network; // last two so that they start once everything above is constructed
+        std::thread dispatch;
+    };
+
+    p2p_host::p2p_host(const natp2p::endpoint_lease& host_endpoint)
+        : p2p_host("0.0.0.0", host_endpoint.data.external_port)
+    {
+    }
+
+    p2p_host::p2p_host(const std::string& ipv4, const std::uint16_t port)
+        : _impl(std::make_shared<host_session_impl>(ipv4, port))
+    {
+    }
+
+    std::uint16_t p2p_host::get_port() const
+    {
+        return _impl->port;
+    }
+
+    std::vector<p2p_client_id> p2p_host::get_clients() const
+    {
+        std::vector<p2p_client_id> clients;
+        {
+            std::lock_guard<std::mutex> lock(_impl->published_infos_mutex);
+            for (const auto& [id, info] : _impl->published_infos) {
+                clients.push_back(id);
+            }
+        }
+        std::sort(clients.begin(), clients.end());
+        return clients;
+    }
+
+    p2p_peer_info p2p_host::get_client_info(const p2p_client_id id) const
+    {
+        std::lock_guard<std::mutex> lock(_impl->published_infos_mutex);
+        const auto info = _impl->published_infos.find(id);
+        if (info == _impl->published_infos.end()) {
+            throw std::invalid_argument("Client id provided to p2p host is not connected");
+        }
+        return info->second;
+    }
+
+    void p2p_host::add_manual_ipv4_endpoint(const std::string& ipv4, const std::uint16_t port)
+    {
+        transport_command command;
+        command.type = transport_command_type::listen;
+        command.host = create_listening_host(ipv4, port);
+        _impl->queues.commands.push(std::move(command));
+    }
+
+    void p2p_host::disconnect(const p2p_client_id id)
+    {
+        transport_command command;
+        command.type = transport_command_type::disconnect;
+        command.id = id;
+        _impl->queues.commands.push(std::move(command));
+    }
+
+    void p2p_host::send(const p2p_client_id id, const std::vector<std::uint8_t>& payload)
+    {
+        transport_command command;
+        command.id = id;
+        set_frame(payload, _impl->codecs.load(std::memory_order_relaxed), command);
+        _impl->queues.commands.push(std::move(command));
+    }
+
+    void p2p_host::broadcast(const std::vector<std::uint8_t>& payload)
+    {
+        transport_command command;
+        command.type = transport_command_type::broadcast;
+        set_frame(payload, _impl->codecs.load(std::memory_order_relaxed), command);
+        _impl->queues.commands.push(std::move(command));
+    }
+
+    void p2p_host::on_connect(const std::function<void(p2p_client_id)>& connect_callback)
+    {
+        _impl->connect_callback.set(connect_callback);
+    }
+
+    void p2p_host::on_rebind(const std::function<void(p2p_client_id, const p2p_peer_info&)>& rebind_callback)
+    {
+        _impl->rebind_callback.set(rebind_callback);
+    }
+
+    void p2p_host::on_disconnect(const std::function<void(p2p_client_id)>& disconnect_callback)
+    {
+        _impl->disconnect_callback.set(disconnect_callback);
+    }
+
+    void p2p_host::on_receive(const std::function<void(p2p_client_id, const std::vector<std::uint8_t>&)>& receive_callback)
+    {
+        _impl->receive_callback.set(receive_callback);
+    }
+
+    struct client_session_impl {
+        client_session_impl(const natp2p::endpoint_data& host_endpoint, const p2p_client_id client_id)
+            : id(client_id)
+            , host(connect(host_endpoint))
+            , network([this] { run_network(); })
+            , dispatch([this] { run_dispatch(); })
+        {
+        }
+
+        ~client_session_impl()
+        {
+            is_network_running.store(false, std::memory_order_relaxed);
+            network.join();
+            queues.stop();
+            dispatch.join();
+            enet_host_destroy(host);
+        }
+
+        // Blocks until the host accepts, so that the client can send as soon as it exists
+        ENetHost* connect(const natp2p::endpoint_data& host_endpoint)
+        {
+            if (!id) {
+                throw std::invalid_argument("Client id provided to p2p client is 0, which the host refuses");
+            }
+            if (host_endpoint.type == natp2p::endpoint_type::ipv6_global) {
+                throw std::invalid_argument("Endpoint provided to p2p client is IPv6, the ENet transport only reaches IPv4");
+            }
+            ENetAddress address;
+            if (enet_address_set_host(&address, host_endpoint.external_ip.c_str())) {
+                throw std::invalid_argument("Endpoint provided to p2p client has no valid address");
+            }
+            address.port = host_endpoint.external_port;
+            ENetHost* created = enet_host_create(nullptr, 1, channel_count, 0, 0);
+            if (!created) {
+                throw std::runtime_error("Failed to create the ENet host of a p2p client");
+            }
+            peer = enet_host_connect(created, &address, channel_count, id);
+            ENetEvent event;
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(connect_timeout_ms);
+            while (peer && std::chrono::steady_clock::now() < deadline) {
+                if (enet_host_service(created, &event, service_timeout_ms) <= 0) {
+                    continue;
+                }
+                if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
+                    break; // refused
+                }
+                if (event.type == ENET_EVENT_TYPE_CONNECT) {
+                    info = make_peer_info(peer);
+                    published_info = info;
+                    packet_ptr hello = make_hello();
+                    if (!enet_peer_send(peer, 0, hello.get())) {
+                        hello.release();
+                    }
+                    return created;
+                }
+            }
+            peer = nullptr;
+            enet_host_destroy(created);
+            throw std::runtime_error("Failed to connect to the p2p host at " + host_endpoint.external_ip + ":" + std::to_string(host_endpoint.external_port));
+        }
+
+        void run_network()
+        {
+            ENetEvent event;
+            while (is_network_running.load(std::memory_order_relaxed)) {
+                bool isBusy = run_commands();
+                while (enet_host_service(host, &event, 0) > 0) {
+                    handle_event(event);
+                    isBusy = true;
+                }
+                queues.publish_events();
+                publish_info();
+                if (!isBusy) {
+                    wait_sockets(&host, 1, service_timeout_ms);
+                }
+            }
+            if (peer) {
+                enet_peer_disconnect_now(peer, 0);
+                enet_host_flush(host);
+            }
+        }
+
+        [[nodiscard]] bool run_commands()
+        {
+            bool isRun = false;
+            transport_command command;
+            while (queues.commands.try_pop(command)) {
+                isRun = true;
+                if (peer && !enet_peer_send(peer, 0, command.packet.get())) {
+                    info.sent_bytes += command.packet->dataLength;
+                    info.sent_payload_bytes += command.payload_size;
+                    info.compression_time += command.compression_time;
+                    is_info_changed = true;
+                    command.packet.release();
+                }
+            }
+            return isRun;
+        }
+
+        void handle_event(const ENetEvent& event)
+        {
+            if (event.type == ENET_EVENT_TYPE_RECEIVE) {
+                packet_ptr packet(event.packet);
+                info.received_bytes += packet->dataLength;
+                info.last_seen = std::chrono::steady_clock::now();
+                is_info_changed = true;
+                if (is_hello(packet.get())) {
+                    codecs.store(read_hello(packet.get()), std::memory_order_relaxed);
+                    return;
+                }
+                const auto start = std::chrono::steady_clock::now();
+                std::vector<std::uint8_t> payload;
+                if (!read_frame(packet.get(), payload)) {
+                    return;
+                }
+                info.received_payload_bytes += payload.size();
+                info.decompression_time += std::chrono::steady_clock::now() - start;
+                queues.push_event({ transport_event_type::receive, 0, std::move(payload), {} });
+            } else if (event.type == ENET_EVENT_TYPE_DISCONNECT) {
+                peer = nullptr;
+                queues.push_event({ transport_event_type::disconnect, 0, {}, {} });
+            }
+        }
+
+        void publish_info()
+        {
+            if (!is_info_changed) {
+                return;
+            }
+            std::unique_lock<std::mutex> lock(published_info_mutex, std::try_to_lock);
+            if (lock.owns_lock()) {
+                published_info = info;
+                is_info_changed = false;
+            }
+        }
+
+        void run_dispatch()
+        {
+            queues.dispatch_events([this](transport_event& event) {
+                if (event.type == transport_event_type::receive) {
+                    if (const auto callback = receive_callback.get()) {
+                        (*callback)(event.payload);
+                    }
+                } else if (const auto callback = disconnect_callback.get()) {
+                    (*callback)();
+                }
+            });
+        }
+
+        enet_lib lib;
+        p2p_client_id id;
+        ENetPeer* peer = nullptr; // network thread only once it runs, nullptr once the host is gone
+        p2p_peer_info info {}; // network thread only
+        bool is_info_changed = false; // network thread only
+        std::atomic<std::uint8_t> codecs { uncompressed_codecs }; // decoded by the host, known once its hello arrives
+        std::mutex published_info_mutex;
+        p2p_peer_info published_info {};
+        ENetHost* host;
+        callback_slot<std::function<void()>> disconnect_callback;
+        callback_slot<std::function<void(const std::vector<std::uint8_t>&)>> receive_callback;
+        transport_queues queues;
+        std::atomic<bool> is_network_running { true };
+        std::thread network; // last two so that they start once everything above is constructed
+        std::thread dispatch;
+    };
+
+    p2p_client::p2p_client(const natp2p::endpoint_data& host_endpoint)
+        : p2p_client(host_endpoint, make_client_id())
+    {
+    }
+
+    p2p_client::p2p_client(const natp2p::endpoint_data& host_endpoint, const p2p_client_id id)
+        : _impl(std::make_shared<client_session_impl>(host_endpoint, id))
+    {
+    }
+
+    p2p_client_id p2p_client::get_id() const
+    {
+        return _impl->id;
+    }
+
+    p2p_peer_info p2p_client::get_host_info() const
+    {
+        std::lock_guard<std::mutex> lock(_impl->published_info_mutex);
+        return _impl->published_info;
+    }
+
+    void p2p_client::send(const std::vector<std::uint8_t>& payload)
+    {
+        transport_command command;
+        set_frame(payload, _impl->codecs.load(std::memory_order_relaxed), command);
+        _impl->queues.commands.push(std::move(command));
+    }
+
+    void p2p_client::on_disconnect(const std::function<void()>& disconnect_callback)
+    {
+        _impl->disconnect_callback.set(disconnect_callback);
+    }
+
+    void p2p_client::on_receive(const std::function<void(const std::vector<std::uint8_t>&)>& receive_callback)
+    {
+        _impl->receive_callback.set(receive_callback);
+    }
+
+}
+}
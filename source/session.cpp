@@ -1,79 +1,404 @@
 #include <rtdxc/rtdxc.hpp>
 
-#include <enet/enet.h>
+#include <cereal/archives/json.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
 
+#include <algorithm>
+#include <array>
+#include <cmath>
 #include <fstream>
+#include <future>
+#include <mutex>
+#include <sstream>
 #include <thread>
 
 namespace rtdxc {
 namespace {
-    struct enet_lib {
-        enet_lib() { enet_initialize(); }
-        ~enet_lib() { enet_deinitialize(); }
-    };
+    static constexpr std::size_t session_scratch_arena_size = 1 << 20; // grows to the largest event on its own
 
-    enum struct wire_type : std::uint8_t {
-        join = 1, // C->H : request to join
-        join_container = 2, // H->C : full project_container blob (on join)
-        commit_request = 3, // C->H : client requests to commit (payload = message + optional diff)
-        commit_broadcast = 4, // H->* : authoritative commit from host (payload = project_commit or minimal wire form)
-        undo_broadcast = 7, // H->* : host performed undo
-        redo_broadcast = 8, // H->* : host performed redo
-        ping = 9, // keepalive if you want
-    };
+    void merge_changes(detail::entity_changes& into, const detail::entity_changes& changes)
+    {
+        into.mixer_tracks.insert(changes.mixer_tracks.begin(), changes.mixer_tracks.end());
+        into.audio_sequencers.insert(changes.audio_sequencers.begin(), changes.audio_sequencers.end());
+        into.midi_sequencers.insert(changes.midi_sequencers.begin(), changes.midi_sequencers.end());
+    }
+
+    // Indices of the commits kept, ascending after the base state 0, the others squash into the next kept one
+    [[nodiscard]] std::vector<std::size_t> select_kept_commits(const std::vector<std::chrono::system_clock::time_point>& times, const retention_policy& policy, const std::size_t pinned)
+    {
+        using days = std::chrono::duration<std::int64_t, std::ratio<86400>>;
+        const std::size_t _count = times.size();
+        std::vector<bool> _is_kept(_count + 1, false);
+        _is_kept[0] = true;
+        _is_kept[_count] = true;
+        if (pinned <= _count) {
+            _is_kept[pinned] = true;
+        }
+        for (std::size_t _index = _count - std::min(policy.keep_last, _count) + 1; _index <= _count; _index++) {
+            _is_kept[_index] = true;
+        }
+        if (policy.keep_daily_anchors) {
+            const std::chrono::system_clock::time_point _unknown;
+            for (std::size_t _index = 1; _index < _count; _index++) {
+                const std::chrono::system_clock::time_point _time = times[_index - 1];
+                const std::chrono::system_clock::time_point _next_time = times[_index];
+                if (_time != _unknown && (_next_time == _unknown || std::chrono::floor<days>(_next_time.time_since_epoch()) != std::chrono::floor<days>(_time.time_since_epoch()))) {
+                    _is_kept[_index] = true;
+                }
+            }
+        }
 
-    struct wire_peer {
-        std::string username;
-        daw_version version;
+        std::vector<std::size_t> _kept;
+        for (std::size_t _index = 0; _index <= _count; _index++) {
+            if (_is_kept[_index]) {
+                _kept.push_back(_index);
+            }
+        }
+        return _kept;
+    }
 
-        template <typename archive_t>
-        void serialize(archive_t& archive)
+    // Times the stages of opening a session, the DAW launch reports from its own thread
+    struct startup_timer {
+        explicit startup_timer(const std::function<void(const session_stage_timing&)>& stage_callback)
+            : callback(stage_callback)
+            , origin(std::chrono::steady_clock::now())
         {
-            archive(username);
-            archive(version);
         }
+
+        template <typename task_t>
+        void run(const session_stage stage, task_t&& task)
+        {
+            const std::chrono::steady_clock::time_point _start = std::chrono::steady_clock::now();
+            task();
+            const session_stage_timing _timing { stage, _start - origin, std::chrono::steady_clock::now() - _start };
+            std::lock_guard<std::mutex> _lock(mutex);
+            timings.push_back(_timing);
+            if (callback) {
+                callback(_timing);
+            }
+        }
+
+        const std::function<void(const session_stage_timing&)>& callback;
+        const std::chrono::steady_clock::time_point origin;
+        std::mutex mutex;
+        std::vector<session_stage_timing> timings;
     };
 
-    struct wire_join {
-        // wire_peer;
+    // Buckets a sixteenth of a power of two wide from 1us up, a percentile reads back within 1/32 of what was recorded
+    struct latency_histogram {
+        static constexpr std::uint64_t sub_bucket_count = 16;
 
-        template <typename archive_t>
-        void serialize(archive_t& archive)
+        void record(const std::chrono::steady_clock::duration latency)
         {
-            archive(version);
+            const std::int64_t _micros = std::chrono::duration_cast<std::chrono::microseconds>(latency).count();
+            counts[get_bucket(static_cast<std::uint64_t>(std::max<std::int64_t>(_micros, 0)))]++;
+            count++;
+            max = std::max(max, latency);
+        }
+
+        [[nodiscard]] latency_summary summarize() const
+        {
+            return { count, get_percentile(0.5), get_percentile(0.99), max };
+        }
+
+        [[nodiscard]] static std::size_t get_bucket(const std::uint64_t micros)
+        {
+            std::uint64_t _shift = 0;
+            while ((micros >> _shift) >= 2 * sub_bucket_count) {
+                _shift++;
+            }
+            return static_cast<std::size_t>(micros < sub_bucket_count ? micros : (_shift + 1) * sub_bucket_count + (micros >> _shift) - sub_bucket_count);
         }
+
+        [[nodiscard]] std::chrono::steady_clock::duration get_percentile(const double quantile) const
+        {
+            const std::size_t _rank = std::max<std::size_t>(static_cast<std::size_t>(std::ceil(quantile * static_cast<double>(count))), 1);
+            std::size_t _seen = 0;
+            for (std::size_t _bucket = 0; _bucket < counts.size(); _bucket++) {
+                _seen += counts[_bucket];
+                if (_seen >= _rank) {
+                    const std::uint64_t _shift = _bucket < sub_bucket_count ? 0 : _bucket / sub_bucket_count - 1;
+                    const std::uint64_t _low = _bucket < sub_bucket_count ? _bucket : (_bucket % sub_bucket_count + sub_bucket_count) << _shift;
+                    const std::chrono::microseconds _middle(static_cast<std::int64_t>(_low + ((std::uint64_t(1) << _shift) >> 1)));
+                    return std::min<std::chrono::steady_clock::duration>(_middle, max);
+                }
+            }
+            return {};
+        }
+
+        std::array<std::uint32_t, 64 * sub_bucket_count> counts {};
+        std::size_t count = 0;
+        std::chrono::steady_clock::duration max {};
     };
 
-    struct wire_join_container {
-        fmtdxc::project_container container;
+    // Filled from the watcher and the session worker, read from the caller's thread, never held for long
+    struct save_latency_recorder {
+        void record(const std::chrono::steady_clock::time_point written, const std::array<std::chrono::steady_clock::time_point, 5>& ends)
+        {
+            std::lock_guard<std::mutex> _lock(mutex);
+            watcher_notification.record(ends[0] - written);
+            file_read.record(ends[1] - ends[0]);
+            als_decode.record(ends[2] - ends[1]);
+            conversion.record(ends[3] - ends[2]);
+            diff.record(ends[4] - ends[3]);
+            total.record(ends[4] - written);
+        }
 
-        template <typename archive_t>
-        void serialize(archive_t& archive)
+        [[nodiscard]] save_latency_metrics get_metrics() const
         {
-            archive(container);
+            std::lock_guard<std::mutex> _lock(mutex);
+            save_latency_metrics _metrics;
+            _metrics.watcher_notification = watcher_notification.summarize();
+            _metrics.file_read = file_read.summarize();
+            _metrics.als_decode = als_decode.summarize();
+            _metrics.conversion = conversion.summarize();
+            _metrics.diff = diff.summarize();
+            _metrics.total = total.summarize();
+            _metrics.notified_count = notified_count;
+            _metrics.dropped_count = dropped_count;
+            _metrics.failed_count = failed_count;
+            _metrics.read_bytes = read_bytes;
+            return _metrics;
         }
+
+        mutable std::mutex mutex;
+        latency_histogram watcher_notification;
+        latency_histogram file_read;
+        latency_histogram als_decode;
+        latency_histogram conversion;
+        latency_histogram diff;
+        latency_histogram total;
+        std::size_t notified_count = 0;
+        std::size_t dropped_count = 0;
+        std::size_t failed_count = 0;
+        std::uintmax_t read_bytes = 0;
     };
 
-    struct wire_commit_request {
-        fmtdxc::project_commit commit;
-        
-        template <typename archive_t>
-        void serialize(archive_t& archive)
+    // Watchers report a while after the write, the file time tells how long. an older one was not written for this event
+    [[nodiscard]] std::chrono::steady_clock::time_point get_write_time(const std::filesystem::path& file_path)
+    {
+        const std::chrono::steady_clock::time_point _now = std::chrono::steady_clock::now();
+        std::error_code _error;
+        const std::filesystem::file_time_type _write_time = std::filesystem::last_write_time(file_path, _error);
+        if (_error) {
+            return _now;
+        }
+        const auto _age = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::filesystem::file_time_type::clock::now() - _write_time);
+        return _age > std::chrono::steady_clock::duration::zero() && _age < std::chrono::seconds(1) ? _now - _age : _now;
+    }
+
+    // Decodes a set from the bytes already read, without copying them into a stream of its own
+    struct memory_buffer : std::streambuf {
+        explicit memory_buffer(std::string& bytes)
+        {
+            setg(bytes.data(), bytes.data(), bytes.data() + bytes.size());
+        }
+
+        pos_type seekoff(const off_type offset, const std::ios_base::seekdir direction, const std::ios_base::openmode which) override
         {
-            archive(commit);
+            char* _base = direction == std::ios_base::beg ? eback() : direction == std::ios_base::cur ? gptr() : egptr();
+            if (!(which & std::ios_base::in) || offset < eback() - _base || offset > egptr() - _base) {
+                return pos_type(off_type(-1));
+            }
+            setg(eback(), _base + offset, egptr());
+            return pos_type(gptr() - eback());
         }
+
+        pos_type seekpos(const pos_type position, const std::ios_base::openmode which) override
+        {
+            return seekoff(off_type(position), std::ios_base::beg, which);
+        }
+    };
+
+    // Everything a compaction needs from the session, copied under the lock when it starts
+    struct compaction_input {
+        retention_policy policy;
+        session_options options;
+        std::vector<std::string> messages; // of commits 1 to the commit count
+        std::vector<std::chrono::system_clock::time_point> times; // same, the epoch when unknown
+        std::size_t applied_count = 0;
+        std::size_t history_generation = 0;
+        std::optional<std::string> container_bytes; // when the history misses states that only the container has
+    };
+
+    struct session_compaction {
+        fmtdxc::project_container container;
+        detail::project_history history;
+        std::vector<std::size_t> kept; // old index of every new index
+        std::size_t history_generation = 0;
+        detail::project_hashes last_hashes; // of the last kept state
     };
 
+    void append_state(session_compaction& compaction, const std::string& message, const fmtdxc::project& proj, const std::chrono::system_clock::time_point time)
+    {
+        detail::project_hashes _hashes;
+        detail::hash_project(proj, _hashes);
+        compaction.container.commit(message, proj);
+        compaction.history.commit(compaction.kept.size(), proj, detail::get_changed_entities(compaction.last_hashes, _hashes), time);
+        compaction.last_hashes = std::move(_hashes);
+    }
+
+}
+
+struct local_session_state {
+    std::mutex mutex; // the session worker and the caller's thread both go through it
+    fmtdxc::project_container container; // only brought to applied_count when it is committed over or written whole
+    std::size_t applied_count = 0; // fmtdxc only moves the applied commit of a container by replaying commits, undo and redo move this instead
+    std::optional<detail::working_project> head_proj; // state after applied_count commits, sharing the nodes of the history
+    fmtdxc::sparse_project next_diff; // for ui
+    std::optional<detail::working_project> next_proj; // the head with what the DAW saved since written over it, whole only where fmtdxc needs it
+    detail::project_hashes head_hashes; // of head_proj
+    detail::project_hashes next_hashes; // of next_proj
+    detail::entity_changes uncommitted_changes; // entities written since next_proj last matched the head, the only ones a diff has to look at
+    std::optional<detail::project_history> history; // undo and redo rebuild states from here, the container only keeps the commit log
+    std::filesystem::path als_document_path; // last document the DAW has, imported again and patched on undo/redo
+    detail::als_identity_map als_identities;
+    detail::als_conversion_cache als_cache;
+    detail::scratch_arena scratch_arena { session_scratch_arena_size }; // converter scratch memory, released after each event
+    detail::worker_pool conversion_pool { 0 }; // every hardware thread, started once for the whole session
+    session_options options;
+    std::size_t history_generation = 0; // bumped when a commit drops states that could have been redone
+    std::size_t container_generation = 0; // bumped when the commits of the container change, undo and redo leave it
+    save_latency_recorder save_latency;
+    std::optional<detail::container_journal> journal; // set for journaled sessions opened from a container
+    std::optional<detail::container_autosave> autosave; // set for autosaved sessions opened from a container, after what it saves
+    std::future<std::optional<session_compaction>> compaction_task; // last, so that the state outlives a running compaction
+};
+
+namespace {
+
+    // Replays the undos and redos the container missed, the journal already holds them
+    void sync_container(fmtdxc::project_container& container, const std::size_t applied_count)
+    {
+        while (container.get_applied_count() > applied_count) {
+            container.undo();
+        }
+        while (container.get_applied_count() < applied_count) {
+            container.redo();
+        }
+    }
+
+    void sync_container(local_session_state& state)
+    {
+        sync_container(state.container, state.applied_count);
+    }
+
+    // Both sides only hold the header and the entities written since the head, every other one is equal
+    void update_diff(local_session_state& state)
+    {
+        detail::diff(state.head_proj->materialize(state.uncommitted_changes), state.head_hashes, state.next_proj->materialize(state.uncommitted_changes), state.next_hashes, state.uncommitted_changes, state.next_diff);
+    }
+
+    // Appending costs what the commit wrote, the whole container is only written again once replaying its journal would cost more
+    void rewrite_outgrown_container(local_session_state& state)
+    {
+        if (static_cast<double>(state.journal->get_journal_bytes()) > state.options.journal_compaction_ratio * static_cast<double>(state.journal->get_container_bytes())) {
+            sync_container(state);
+            state.journal->rewrite(state.container);
+        }
+    }
+
+    // Runs off the caller's thread, the lock is only held to read one state at a time
+    [[nodiscard]] std::optional<session_compaction> build_compaction(local_session_state& state, const compaction_input& input)
+    {
+        std::optional<fmtdxc::project_container> _clone;
+        std::size_t _clone_index = input.applied_count;
+        if (input.container_bytes) {
+            std::istringstream _stream(input.container_bytes.value(), std::ios::binary);
+            fmtdxc::version _version;
+            fmtdxc::import_container(_stream, _clone.emplace(), _version);
+        }
+
+        const auto _get_state = [&](const std::size_t _index) -> std::shared_ptr<const fmtdxc::project> {
+            {
+                std::lock_guard<std::mutex> _lock(state.mutex);
+                if (state.history_generation != input.history_generation) {
+                    return nullptr; // a commit rewrote the history, the squashed states no longer exist
+                }
+                if (state.history->contains(_index)) {
+                    return state.history->get_project(_index);
+                }
+            }
+            for (; _clone_index > _index; _clone_index--) {
+                _clone->undo();
+            }
+            for (; _clone_index < _index; _clone_index++) {
+                _clone->redo();
+            }
+            return std::make_shared<const fmtdxc::project>(_clone->get_project());
+        };
+
+        const std::shared_ptr<const fmtdxc::project> _base = _get_state(0);
+        if (!_base) {
+            return std::nullopt;
+        }
+        session_compaction _compaction {
+            fmtdxc::project_container(*_base),
+            detail::project_history(*_base, 0, input.options.checkpoint_interval, input.options.checkout_cache_capacity),
+            { 0 },
+            input.history_generation,
+            {}
+        };
+        detail::hash_project(*_base, _compaction.last_hashes);
+
+        const std::vector<std::size_t> _kept = select_kept_commits(input.times, input.policy, input.applied_count);
+        for (std::size_t _position = 1; _position < _kept.size(); _position++) {
+            const std::shared_ptr<const fmtdxc::project> _proj = _get_state(_kept[_position]);
+            if (!_proj) {
+                return std::nullopt;
+            }
+            const std::size_t _squashed_count = _kept[_position] - _kept[_position - 1] - 1;
+            std::string _message = input.messages[_kept[_position] - 1];
+            if (_squashed_count) {
+                _message += " (+" + std::to_string(_squashed_count) + " squashed)";
+            }
+            append_state(_compaction, _message, *_proj, input.times[_kept[_position] - 1]);
+            _compaction.kept.push_back(_kept[_position]);
+        }
+        return _compaction;
+    }
+
+}
+
+void export_save_latency_metrics(std::ostream& stream, const save_latency_metrics& metrics)
+{
+    cereal::JSONOutputArchive _archive(stream);
+    const auto _save_summary = [&_archive](const char* _name, const latency_summary& _summary) {
+        const auto _to_micros = [](const std::chrono::steady_clock::duration _duration) {
+            return static_cast<std::int64_t>(std::chrono::duration_cast<std::chrono::microseconds>(_duration).count());
+        };
+        _archive.setNextName(_name);
+        _archive.startNode();
+        _archive(cereal::make_nvp("count", static_cast<std::uint64_t>(_summary.count)));
+        _archive(cereal::make_nvp("p50_us", _to_micros(_summary.p50)));
+        _archive(cereal::make_nvp("p99_us", _to_micros(_summary.p99)));
+        _archive(cereal::make_nvp("max_us", _to_micros(_summary.max)));
+        _archive.finishNode();
+    };
+    _save_summary("watcher_notification", metrics.watcher_notification);
+    _save_summary("file_read", metrics.file_read);
+    _save_summary("als_decode", metrics.als_decode);
+    _save_summary("conversion", metrics.conversion);
+    _save_summary("diff", metrics.diff);
+    _save_summary("total", metrics.total);
+    _archive(cereal::make_nvp("notified_count", static_cast<std::uint64_t>(metrics.notified_count)));
+    _archive(cereal::make_nvp("coalesced_count", static_cast<std::uint64_t>(metrics.coalesced_count)));
+    _archive(cereal::make_nvp("dropped_count", static_cast<std::uint64_t>(metrics.dropped_count)));
+    _archive(cereal::make_nvp("failed_count", static_cast<std::uint64_t>(metrics.failed_count)));
+    _archive(cereal::make_nvp("read_bytes", static_cast<std::uint64_t>(metrics.read_bytes)));
 }
 
 local_session::local_session(
     const daw_version version,
     const std::filesystem::path& daw_path,
     const std::optional<std::filesystem::path>& container_path,
-    const std::function<std::optional<std::filesystem::path>()>& exit_callback)
+    const std::function<std::optional<std::filesystem::path>()>& exit_callback,
+    const session_options& options)
     : _daw_version(version)
     // , _temp_directory_path(std::filesystem::temp_directory_path())
     , _temp_directory_path("C:\\Users\\adri\\Desktop\\temp") // LOOOL
+    , _state(std::make_shared<local_session_state>())
 {
     if (!std::filesystem::exists(daw_path)) {
         throw std::invalid_argument("DAW path provided to session does not exist");
@@ -86,19 +411,10 @@ local_session::local_session(
     if (!exit_callback) {
         throw std::invalid_argument("Close callback provided to session is nullptr");
     }
-
-    fmtdxc::version _dxcc_version;
-    if (container_path) {
-        std::ifstream _dxcc_stream(container_path.value(), std::ios::binary);
-        fmtdxc::import_container(_dxcc_stream, _container, _dxcc_version);
+    if (options.is_journaled && options.is_autosaved) {
+        throw std::invalid_argument("Options provided to session both journal and autosave the container");
     }
 
-    //
-    //
-    //
-    //
-
-    std::filesystem::path _daw_temp_project_path;
     std::visit([&](const auto _version) {
         using daw_type_t = std::decay_t<decltype(_version)>;
 
@@ -109,35 +425,82 @@ local_session::local_session(
     },
         _daw_version);
 
-    //
-    //
-    //
-    //
+    // The DAW takes seconds to show its window, the container is decoded, converted and written meanwhile
+    startup_timer _timer(options.stage_callback);
+    std::future<std::unique_ptr<detail::process>> _daw_launch = std::async(std::launch::async, [&_timer, daw_path]() {
+        std::unique_ptr<detail::process> _process;
+        _timer.run(session_stage::daw_launch, [&]() {
+            _process = std::make_unique<detail::process>(daw_path);
+        });
+        return _process;
+    });
 
     if (container_path) {
+        _timer.run(session_stage::container_import, [&]() {
+            if (options.is_journaled) {
+                _state->journal.emplace(container_path.value(), _state->container, options.journal_sync_window);
+            } else {
+                detail::load_container(container_path.value(), _state->container);
+            }
+        });
         std::visit([&](const auto _version) {
             using daw_type_t = std::decay_t<decltype(_version)>;
 
             // ableton
             if constexpr (std::is_same_v<daw_type_t, fmtals::version>) {
-                fmtals::project _als_project = detail::convert_to_als(_container.get_project());
-                std::ofstream _als_stream(_daw_temp_project_path, std::ios::binary);
-
-                // TODO export in parent folder Project
-                fmtals::export_project(_als_stream, _als_project, _version);
+                fmtals::project _als_project;
+                _timer.run(session_stage::conversion, [&]() {
+                    const detail::conversion_options _options { 0, _state->scratch_arena.get_resource(), &_state->conversion_pool };
+                    _als_project = detail::convert_to_als(_state->container.get_project(), _state->als_identities, _options);
+                });
+                _timer.run(session_stage::als_export, [&]() {
+                    std::ofstream _als_stream(_daw_temp_project_path, std::ios::binary);
+
+                    // TODO export in parent folder Project
+                    fmtals::export_project(_als_stream, _als_project, _version);
+                });
+                _state->als_document_path = _daw_temp_project_path;
             }
         },
             _daw_version);
+        _state->scratch_arena.reset();
     }
-
-    _daw_process = std::make_unique<detail::process>(daw_path);
-
-    if (container_path) {
-        _daw_process->load_daw_project(_daw_temp_project_path);
-    } else {
-        _daw_process->save_daw_project_as(_daw_temp_project_path);
+    _timer.run(session_stage::history_setup, [&]() {
+        detail::hash_project(_state->container.get_project(), _state->head_hashes);
+        _state->next_hashes = _state->head_hashes;
+        _state->options = options;
+        _state->applied_count = _state->container.get_applied_count();
+        _state->history.emplace(_state->container.get_project(), _state->applied_count, options.checkpoint_interval, options.checkout_cache_capacity);
+        _state->head_proj.emplace(_state->history.value(), _state->applied_count);
+        _state->next_proj.emplace(_state->history.value(), _state->applied_count);
+    });
+    if (container_path && options.is_autosaved) {
+        // The lock is only held to read the applied count, and to copy the container when a commit changed it since the
+        // last save. the save thread replays and exports its own copy
+        _state->autosave.emplace(container_path.value(), [_state = _state.get(), _saved = std::optional<fmtdxc::project_container>(), _saved_generation = std::size_t(0)](std::ostream& _stream) mutable {
+            std::size_t _applied_count = 0;
+            {
+                std::lock_guard<std::mutex> _lock(_state->mutex);
+                if (!_saved || _saved_generation != _state->container_generation) {
+                    _saved = _state->container;
+                    _saved_generation = _state->container_generation;
+                }
+                _applied_count = _state->applied_count;
+            }
+            sync_container(_saved.value(), _applied_count);
+            fmtdxc::export_container(_stream, _saved.value(), fmtdxc::version::alpha);
+        });
     }
 
+    _daw_process = _daw_launch.get();
+    _timer.run(session_stage::daw_load, [&]() {
+        if (container_path) {
+            _daw_process->load_daw_project(_daw_temp_project_path);
+        } else {
+            _daw_process->save_daw_project_as(_daw_temp_project_path);
+        }
+    });
+
     // _daw_process->on_exit([this] () {
     //     std::optional<std::filesystem::path> _output_container_path = _exit_callback();
     //     if (_output_container_path) {
@@ -146,61 +509,131 @@ local_session::local_session(
     //     }
     // });
 
-    // _daw_temp_project_watcher = std::make_unique<detail::file_watcher>(_daw_temp_project_path);
-    _daw_temp_project_watcher = std::make_unique<detail::file_watcher>(_temp_directory_path / "dawxchange Project" / "dawxchange.als");
-    std::filesystem::path _ok = _temp_directory_path;
-    _daw_temp_project_watcher->on_modification([this, _ok](const std::filesystem::path&) {
-        std::cout << _ok / "dawxchange Project" / "dawxchange.als" << std::endl;
-
-        std::visit([&](const auto _version) {
-            using daw_type_t = std::decay_t<decltype(_version)>;
+    // Saves only post to the worker, a burst of them while an import runs collapses into a single next import
+    _worker = std::make_unique<detail::coalescing_worker>();
+    const std::filesystem::path _watched_path = _temp_directory_path / "dawxchange Project" / "dawxchange.als";
+    const std::function<void(std::chrono::steady_clock::time_point)> _import_task = [_state = _state, _version = _daw_version, _watched_path, _worker = _worker.get()](const std::chrono::steady_clock::time_point _written) {
+        std::array<std::chrono::steady_clock::time_point, 5> _ends; // of each stage, the watcher notification first
+        _ends[0] = std::chrono::steady_clock::now();
+        try {
+            std::visit([&](const auto _version) {
+                using daw_type_t = std::decay_t<decltype(_version)>;
+
+                // ableton
+                if constexpr (std::is_same_v<daw_type_t, fmtals::version>) {
+                    std::ifstream _als_stream(_watched_path, std::ios::binary | std::ios::ate);
+                    if (!_als_stream) {
+                        throw std::runtime_error("Failed to open the DAW project saved at " + _watched_path.string());
+                    }
+                    std::string _als_bytes(static_cast<std::size_t>(_als_stream.tellg()), '\0');
+                    _als_stream.seekg(0);
+                    _als_stream.read(_als_bytes.data(), static_cast<std::streamsize>(_als_bytes.size()));
+                    {
+                        std::lock_guard<std::mutex> _latency_lock(_state->save_latency.mutex);
+                        _state->save_latency.read_bytes += static_cast<std::uintmax_t>(_als_stream.gcount());
+                    }
+                    _ends[1] = std::chrono::steady_clock::now();
+
+                    memory_buffer _als_buffer(_als_bytes);
+                    std::istream _als_bytes_stream(&_als_buffer);
+                    fmtals::version _als_version;
+                    fmtals::project _daw_project;
+                    fmtals::import_project(_als_bytes_stream, _daw_project, _als_version);
+                    _ends[2] = std::chrono::steady_clock::now();
+                    if (_worker->is_pending()) {
+                        std::lock_guard<std::mutex> _latency_lock(_state->save_latency.mutex);
+                        _state->save_latency.dropped_count++;
+                        return; // a newer save is already waiting, converting this one would be thrown away
+                    }
+
+                    {
+                        std::lock_guard<std::mutex> _lock(_state->mutex);
+                        const detail::conversion_options _options { 0, _state->scratch_arena.get_resource(), &_state->conversion_pool };
+                        detail::convert_from_als(std::move(_daw_project), _state->als_identities, _state->als_cache, _state->next_proj.value(), _options);
+                        _state->als_document_path = _watched_path; // imported again only if undo/redo has to patch it
+                        detail::rehash_project(_state->next_proj->materialize(_state->als_cache.changes), _state->als_cache.changes, _state->next_hashes);
+                        _ends[3] = std::chrono::steady_clock::now();
+                        merge_changes(_state->uncommitted_changes, _state->als_cache.changes);
+                        update_diff(*_state);
+                        _ends[4] = std::chrono::steady_clock::now();
+                        _state->scratch_arena.reset();
+                    }
+
+                    // recorded once the session lock is released, the stages only measure the pipeline
+                    _state->save_latency.record(_written, _ends);
+                }
+            },
+                _version);
+        } catch (...) {
+            std::lock_guard<std::mutex> _latency_lock(_state->save_latency.mutex);
+            _state->save_latency.failed_count++;
+            throw;
+        }
+    };
 
-            // ableton
-            if constexpr (std::is_same_v<daw_type_t, fmtals::version>) {
-                std::cout << _ok / "dawxchange Project" / "dawxchange.als" << std::endl;
-                std::ifstream _als_stream(_ok / "dawxchange Project" / "dawxchange.als", std::ios::binary);
-                std::cout << _als_stream.is_open() << std::endl;
-                fmtals::version _als_version;
-                fmtals::project _als_project;
-                fmtals::import_project(_als_stream, _als_project, _als_version);
-                // _next_proj = detail::convert_from_als(_als_project);
+    _timer.run(session_stage::watcher_setup, [&]() {
+        // _daw_temp_project_watcher = std::make_unique<detail::file_watcher>(_daw_temp_project_path);
+        _daw_temp_project_watcher = std::make_unique<detail::file_watcher>(_watched_path);
+        _daw_temp_project_watcher->on_modification([_state = _state, _worker = _worker.get(), _import_task, _watched_path](const std::filesystem::path&) {
+            const std::chrono::steady_clock::time_point _written = get_write_time(_watched_path);
+            {
+                std::lock_guard<std::mutex> _latency_lock(_state->save_latency.mutex);
+                _state->save_latency.notified_count++;
             }
-        },
-            _daw_version);
+            _worker->post([_import_task, _written]() {
+                _import_task(_written);
+            });
+        });
+    });
+    _startup_timings = std::move(_timer.timings); // the launch thread is done with them
+}
 
-        // fmtdxc::diff(_container.get_project(), _next_proj, _next_diff);
-        std::cout << "modified ::::) " << std::endl;
+std::future<local_session> local_session::open(
+    const daw_version version,
+    const std::filesystem::path& daw_path,
+    const std::optional<std::filesystem::path>& container_path,
+    const std::function<std::optional<std::filesystem::path>()>& exit_callback,
+    const session_options& options)
+{
+    return std::async(std::launch::async, [version, daw_path, container_path, exit_callback, options]() {
+        return local_session(version, daw_path, container_path, exit_callback, options);
     });
 }
 
 bool local_session::can_commit() const
 {
-    return true; // TODO is next_dif empty
+    std::lock_guard<std::mutex> _lock(_state->mutex);
+    return _state->next_hashes.root != _state->head_hashes.root;
 }
 
 bool local_session::can_undo() const
 {
-    return _container.can_undo();
+    std::lock_guard<std::mutex> _lock(_state->mutex);
+    return _state->applied_count > 0;
 }
 
 bool local_session::can_redo() const
 {
-    return _container.can_redo();
+    std::lock_guard<std::mutex> _lock(_state->mutex);
+    return _state->applied_count < _state->container.get_commits().size();
 }
 
 std::size_t local_session::get_applied_count() const
 {
-    return _container.get_applied_count();
+    std::lock_guard<std::mutex> _lock(_state->mutex);
+    return _state->applied_count;
 }
 
 const std::vector<fmtdxc::project_commit>& local_session::get_commits() const
 {
-    return _container.get_commits();
+    // only the caller's thread commits or installs a compaction, the worker never touches the history
+    return _state->container.get_commits();
 }
 
-const fmtdxc::sparse_project& local_session::get_diff_from_last_commit() const
+fmtdxc::sparse_project local_session::get_diff_from_last_commit() const
 {
-    return _next_diff;
+    std::lock_guard<std::mutex> _lock(_state->mutex);
+    return _state->next_diff;
 }
 
 const std::filesystem::path& local_session::get_temp_directory_path() const
@@ -208,18 +641,247 @@ const std::filesystem::path& local_session::get_temp_directory_path() const
     return _temp_directory_path;
 }
 
+const std::vector<session_stage_timing>& local_session::get_startup_timings() const
+{
+    return _startup_timings;
+}
+
+detail::autosave_metrics local_session::get_autosave_metrics() const
+{
+    return _state->autosave ? _state->autosave->get_metrics() : detail::autosave_metrics {};
+}
+
+save_latency_metrics local_session::get_save_latency_metrics() const
+{
+    save_latency_metrics _metrics = _state->save_latency.get_metrics();
+    _metrics.coalesced_count = _worker->get_coalesced_count(); // the worker only ever runs imports
+    return _metrics;
+}
+
+std::shared_ptr<const fmtdxc::project> local_session::project_at(const std::size_t commit_index) const
+{
+    std::lock_guard<std::mutex> _lock(_state->mutex);
+    if (!_state->history->contains(commit_index)) {
+        throw std::invalid_argument("Commit index provided to project_at is not in the session history");
+    }
+    return _state->history->get_project(commit_index);
+}
+
+void local_session::compact(const retention_policy& policy)
+{
+    if (is_compacting()) {
+        return;
+    }
+
+    compaction_input _input;
+    _input.policy = policy;
+    _input.options = _state->options;
+    {
+        std::lock_guard<std::mutex> _lock(_state->mutex);
+        const std::vector<fmtdxc::project_commit>& _commits = _state->container.get_commits();
+        const detail::project_history& _history = _state->history.value();
+        _input.messages.reserve(_commits.size());
+        _input.times.reserve(_commits.size());
+        for (std::size_t _index = 1; _index <= _commits.size(); _index++) {
+            const bool _is_timed = _index > _history.get_first_index() && _index <= _history.get_last_index();
+            _input.messages.push_back(_commits[_index - 1].message);
+            _input.times.push_back(_is_timed ? _history.get_commit_time(_index) : std::chrono::system_clock::time_point());
+        }
+        _input.applied_count = _state->applied_count;
+        _input.history_generation = _state->history_generation;
+        if (_history.get_first_index() > 0 || _history.get_last_index() < _commits.size()) {
+            sync_container(*_state);
+            std::ostringstream _stream(std::ios::binary);
+            fmtdxc::export_container(_stream, _state->container, fmtdxc::version::alpha);
+            _input.container_bytes = _stream.str();
+        }
+    }
+
+    _state->compaction_task = std::async(std::launch::async, [_state = _state.get(), _input = std::move(_input)]() {
+        return build_compaction(*_state, _input);
+    });
+}
+
+bool local_session::apply_compaction()
+{
+    if (!_state->compaction_task.valid() || _state->compaction_task.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        return false;
+    }
+    std::optional<session_compaction> _compaction = _state->compaction_task.get(); // rethrows what the compaction threw
+    if (!_compaction) {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> _lock(_state->mutex);
+    if (_state->history_generation != _compaction->history_generation) {
+        return false;
+    }
+
+    // Commits made while it ran are all in the history, they join the compacted one as they are
+    const std::vector<fmtdxc::project_commit>& _commits = _state->container.get_commits();
+    for (std::size_t _index = _compaction->kept.back() + 1; _index <= _commits.size(); _index++) {
+        append_state(_compaction.value(), _commits[_index - 1].message, *_state->history->get_project(_index), _state->history->get_commit_time(_index));
+        _compaction->kept.push_back(_index);
+    }
+
+    const auto _applied = std::find(_compaction->kept.begin(), _compaction->kept.end(), _state->applied_count);
+    if (_applied == _compaction->kept.end()) {
+        return false;
+    }
+    for (auto _undone = std::next(_applied); _undone != _compaction->kept.end(); ++_undone) {
+        _compaction->container.undo();
+    }
+    _state->container = std::move(_compaction->container);
+    _state->container_generation++;
+    _state->applied_count = _state->container.get_applied_count();
+    const fmtdxc::project _uncommitted = _state->next_proj->materialize(_state->uncommitted_changes);
+    _state->history.emplace(std::move(_compaction->history));
+
+    // The working projects hold nodes of the history just replaced, the uncommitted entities are written again over the new one
+    _state->head_proj.emplace(_state->history.value(), _state->applied_count);
+    _state->next_proj.emplace(_state->history.value(), _state->applied_count);
+    _state->next_proj->assign(_uncommitted, _state->uncommitted_changes);
+    if (_state->journal) {
+        _state->journal->rewrite(_state->container); // the journal records commits that no longer exist
+    }
+    if (_state->autosave) {
+        _state->autosave->notify();
+    }
+    return true;
+}
+
+bool local_session::is_compacting() const
+{
+    return _state->compaction_task.valid() && _state->compaction_task.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+}
+
 void local_session::commit(const std::string& message)
 {
-    _container.commit(message, _next_proj);
+    std::lock_guard<std::mutex> _lock(_state->mutex);
+    const detail::entity_changes _changes = detail::get_changed_entities(_state->head_hashes, _state->next_hashes, _state->uncommitted_changes);
+    if (_state->applied_count < _state->container.get_commits().size()) {
+        _state->history_generation++; // the commits that could have been redone are gone
+    }
+    const fmtdxc::project _committed = _state->next_proj->materialize(); // fmtdxc only commits whole projects
+    sync_container(*_state);
+    _state->container.commit(message, _committed);
+    _state->container_generation++;
+    _state->applied_count++;
+    _state->history->commit(_state->applied_count, _state->next_proj.value(), _changes, std::chrono::system_clock::now());
+    _state->head_proj.emplace(_state->history.value(), _state->applied_count);
+    if (_state->journal) {
+        _state->journal->append_commit(message, _committed, _changes);
+        rewrite_outgrown_container(*_state);
+    }
+    if (_state->autosave) {
+        _state->autosave->notify();
+    }
+    _state->head_hashes = _state->next_hashes;
+    _state->uncommitted_changes = {};
+    update_diff(*_state);
 }
 
 void local_session::undo()
 {
-    _container.undo();
+    {
+        std::lock_guard<std::mutex> _lock(_state->mutex);
+        if (!_state->applied_count) {
+            throw std::runtime_error("Session has no commit to undo");
+        }
+        reload_daw_project(_state->applied_count - 1);
+        if (_state->journal) {
+            _state->journal->append_undo();
+        }
+        if (_state->autosave) {
+            _state->autosave->notify();
+        }
+    }
+
+    // outside the lock, the DAW saving its current set on the way triggers the worker
+    _daw_process->load_daw_project(_daw_temp_project_path);
 }
 
 void local_session::redo()
 {
-    _container.redo();
+    {
+        std::lock_guard<std::mutex> _lock(_state->mutex);
+        if (_state->applied_count == _state->container.get_commits().size()) {
+            throw std::runtime_error("Session has no commit to redo");
+        }
+        reload_daw_project(_state->applied_count + 1);
+        if (_state->journal) {
+            _state->journal->append_redo();
+        }
+        if (_state->autosave) {
+            _state->autosave->notify();
+        }
+    }
+    _daw_process->load_daw_project(_daw_temp_project_path);
+}
+
+void local_session::reload_daw_project(const std::size_t index)
+{
+    if (index < _state->history->get_first_index()) {
+        sync_container(_state->container, index);
+        _state->history->prepend(_state->container.get_project()); // states before the loaded one only exist in the container
+    } else if (index > _state->history->get_last_index()) {
+        sync_container(_state->container, index); // and so do the ones it loaded as redoable
+        detail::project_hashes _redone_hashes;
+        detail::hash_project(_state->container.get_project(), _redone_hashes);
+        _state->history->commit(index, _state->container.get_project(), detail::get_changed_entities(_state->head_hashes, _redone_hashes), std::chrono::system_clock::time_point());
+    }
+    detail::working_project _checked_out(_state->history.value(), index); // leaves the materialized cache of the history to project_at
+    const fmtdxc::project _from = _state->next_proj->materialize();
+    const fmtdxc::project _to = _checked_out.materialize();
+    try {
+        std::visit([&](const auto _version) {
+            using daw_type_t = std::decay_t<decltype(_version)>;
+
+            // ableton
+            if constexpr (std::is_same_v<daw_type_t, fmtals::version>) {
+                const detail::conversion_options _options { 0, _state->scratch_arena.get_resource(), &_state->conversion_pool };
+                detail::als_identity_map _identities = _state->als_identities; // patched copies, kept once the set is written
+                detail::als_conversion_cache _cache = _state->als_cache;
+                fmtals::project _als_project;
+                std::ifstream _document_stream(_state->als_document_path, std::ios::binary);
+                if (_document_stream) {
+                    fmtals::version _als_version;
+                    fmtals::import_project(_document_stream, _als_project, _als_version);
+                } else {
+                    _als_project = detail::convert_to_als(_from, _identities, _options); // the DAW never saved nor loaded a set yet
+                }
+                _document_stream.close();
+                detail::patch_als(_als_project, _from, _to, _identities, _cache, _options);
+
+                // written beside then moved over, the set the DAW last loaded stays whole if the export fails
+                std::filesystem::path _written_path = _daw_temp_project_path;
+                _written_path += ".part";
+                {
+                    std::ofstream _als_stream(_written_path, std::ios::binary);
+                    fmtals::export_project(_als_stream, _als_project, _version);
+                    if (!_als_stream.flush()) {
+                        throw std::runtime_error("Failed to write the DAW project to " + _written_path.string());
+                    }
+                }
+                std::filesystem::rename(_written_path, _daw_temp_project_path);
+                _state->als_identities = std::move(_identities);
+                _state->als_cache = std::move(_cache);
+                _state->als_document_path = _daw_temp_project_path;
+            }
+        },
+            _daw_version);
+    } catch (...) {
+        _state->scratch_arena.reset();
+        throw;
+    }
+
+    _state->scratch_arena.reset();
+    _state->applied_count = index;
+    _state->next_proj = std::move(_checked_out);
+    _state->head_proj.emplace(_state->history.value(), index);
+    detail::hash_project(_to, _state->head_hashes);
+    _state->next_hashes = _state->head_hashes;
+    _state->uncommitted_changes = {};
+    update_diff(*_state);
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,701 @@
+#include <rtdxc/rtdxc.hpp>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/optional.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/utility.hpp>
+#include <cereal/types/vector.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace rtdxc {
+namespace detail {
+
+    namespace {
+
+        constexpr char journal_magic[4] = { 'D', 'X', 'C', 'J' };
+        constexpr std::uint32_t journal_format = 2; // commit records carry symbols since 2
+        constexpr std::size_t journal_header_size = sizeof(journal_magic) + sizeof(std::uint32_t) + sizeof(std::uint64_t);
+        constexpr std::size_t record_header_size = sizeof(std::uint32_t) + sizeof(std::uint64_t);
+
+        enum struct record_type : std::uint8_t {
+            commit = 1,
+            undo = 2,
+            redo = 3,
+            symbols = 4, // names the next commit interned, ahead of it
+        };
+
+        std::uint64_t hash_bytes(const char* data, const std::size_t count)
+        {
+            std::uint64_t hash = 1469598103934665603ull;
+            for (std::size_t i = 0; i < count; ++i) {
+                hash ^= static_cast<unsigned char>(data[i]);
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        template <typename value_t>
+        void append_value(std::string& bytes, const value_t value)
+        {
+            char data[sizeof(value_t)];
+            std::memcpy(data, &value, sizeof(value_t));
+            bytes.append(data, sizeof(value_t));
+        }
+
+        template <typename value_t>
+        value_t read_value(const std::string& bytes, const std::size_t offset)
+        {
+            value_t value;
+            std::memcpy(&value, bytes.data() + offset, sizeof(value_t));
+            return value;
+        }
+
+        std::string make_journal_header(const std::uint64_t container_hash)
+        {
+            std::string header(journal_magic, sizeof(journal_magic));
+            append_value(header, journal_format);
+            append_value(header, container_hash);
+            return header;
+        }
+
+        // Size and checksum first, so that a record cut short by a crash is told apart from a whole one
+        std::string make_record(const std::string& payload)
+        {
+            std::string record;
+            record.reserve(record_header_size + payload.size());
+            append_value(record, static_cast<std::uint32_t>(payload.size()));
+            append_value(record, hash_bytes(payload.data(), payload.size()));
+            record += payload;
+            return record;
+        }
+
+        template <typename map_t>
+        void record_writes(const map_t& entities, const std::unordered_set<std::uint32_t>& changed, symbol_table& symbols, entity_writes<interned<typename map_t::mapped_type>>& writes)
+        {
+            writes.reserve(changed.size());
+            for (const std::uint32_t id : changed) {
+                const auto entity = entities.find(id);
+                if (entity == entities.end()) {
+                    writes.emplace_back(id, std::nullopt);
+                } else {
+                    writes.emplace_back(id, intern_names(entity->second, symbols));
+                }
+            }
+        }
+
+        template <typename map_t>
+        void apply_writes(const entity_writes<interned<typename map_t::mapped_type>>& writes, const symbol_table& symbols, map_t& entities)
+        {
+            for (const auto& [id, entity] : writes) {
+                if (entity) {
+                    entities.insert_or_assign(id, resolve_names(*entity, symbols));
+                } else {
+                    entities.erase(id);
+                }
+            }
+        }
+
+        struct symbols_record {
+            std::uint64_t first = 0; // id of texts.front()
+            std::vector<std::string> texts;
+
+            template <typename archive_t>
+            void serialize(archive_t& archive)
+            {
+                archive(first);
+                archive(texts);
+            }
+        };
+
+        std::string read_file(const std::filesystem::path& path)
+        {
+            std::ifstream stream(path, std::ios::binary);
+            if (!stream) {
+                throw std::runtime_error("Failed to open " + path.string());
+            }
+            std::ostringstream bytes(std::ios::binary);
+            bytes << stream.rdbuf();
+            return bytes.str();
+        }
+
+        std::filesystem::path get_journal_path(const std::filesystem::path& container_path)
+        {
+            std::filesystem::path journalPath = container_path;
+            journalPath += ".journal";
+            return journalPath;
+        }
+
+        // Replays the records that apply to this container, returns the size of the journal up to the last whole one or 0 when none applies.
+        // symbols ends up holding the names the replayed records interned, appending after them goes on from there
+        std::uintmax_t replay_journal(const std::filesystem::path& journal_path, const std::uint64_t container_hash, fmtdxc::project_container& container, symbol_table& symbols)
+        {
+            if (!std::filesystem::exists(journal_path)) {
+                return 0;
+            }
+            const std::string bytes = read_file(journal_path);
+            if (bytes.size() < journal_header_size || bytes.compare(0, journal_header_size, make_journal_header(container_hash)) != 0) {
+                return 0; // left over from before the container was last written whole
+            }
+
+            std::size_t offset = journal_header_size;
+            while (offset + record_header_size <= bytes.size()) {
+                const std::uint32_t payloadSize = read_value<std::uint32_t>(bytes, offset);
+                const std::uint64_t payloadHash = read_value<std::uint64_t>(bytes, offset + sizeof(std::uint32_t));
+                const std::size_t payloadOffset = offset + record_header_size;
+                if (payloadSize > bytes.size() - payloadOffset || hash_bytes(bytes.data() + payloadOffset, payloadSize) != payloadHash) {
+                    break; // torn by a crash, nothing after it was synced either
+                }
+
+                std::istringstream payload(bytes.substr(payloadOffset, payloadSize), std::ios::binary);
+                cereal::BinaryInputArchive archive(payload);
+                record_type type;
+                archive(type);
+                if (type == record_type::commit) {
+                    commit_patch patch;
+                    archive(patch);
+                    apply_commit_patch(patch, symbols, container);
+                } else if (type == record_type::symbols) {
+                    symbols_record record;
+                    archive(record);
+                    symbols.import_symbols(record.first, record.texts);
+                } else if (type == record_type::undo) {
+                    container.undo();
+                } else if (type == record_type::redo) {
+                    container.redo();
+                } else {
+                    throw std::runtime_error("Journal provided to container has an unknown record type");
+                }
+                offset = payloadOffset + payloadSize;
+            }
+            return offset;
+        }
+
+        // Writes go straight to the OS without buffering, so that sync covers everything written before it
+        struct append_file {
+            append_file(const std::filesystem::path& path, const bool truncate)
+            {
+#if defined(_WIN32)
+                handle = CreateFileW(path.c_str(), GENERIC_WRITE, FILE_SHARE_READ, NULL, truncate ? CREATE_ALWAYS : OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+                if (handle == INVALID_HANDLE_VALUE) {
+                    throw std::runtime_error("Failed to open " + path.string());
+                }
+                LARGE_INTEGER zero {};
+                SetFilePointerEx(handle, zero, NULL, FILE_END);
+#else
+                descriptor = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | (truncate ? O_TRUNC : 0), 0644);
+                if (descriptor < 0) {
+                    throw std::runtime_error("Failed to open " + path.string());
+                }
+#endif
+            }
+
+            append_file(const append_file& other) = delete;
+            append_file& operator=(const append_file& other) = delete;
+
+            ~append_file()
+            {
+#if defined(_WIN32)
+                CloseHandle(handle);
+#else
+                ::close(descriptor);
+#endif
+            }
+
+            void write(const std::string& bytes)
+            {
+                std::size_t written = 0;
+                while (written < bytes.size()) {
+#if defined(_WIN32)
+                    DWORD count = 0;
+                    if (!WriteFile(handle, bytes.data() + written, static_cast<DWORD>(bytes.size() - written), &count, NULL)) {
+                        throw std::runtime_error("Failed to write journal");
+                    }
+#else
+                    const ::ssize_t count = ::write(descriptor, bytes.data() + written, bytes.size() - written);
+                    if (count < 0) {
+                        if (errno == EINTR) {
+                            continue;
+                        }
+                        throw std::runtime_error("Failed to write journal");
+                    }
+#endif
+                    written += static_cast<std::size_t>(count);
+                }
+            }
+
+            void sync()
+            {
+#if defined(_WIN32)
+                if (!FlushFileBuffers(handle)) {
+#else
+                if (::fsync(descriptor) != 0) {
+#endif
+                    throw std::runtime_error("Failed to sync journal");
+                }
+            }
+
+#if defined(_WIN32)
+            HANDLE handle = INVALID_HANDLE_VALUE;
+#else
+            int descriptor = -1;
+#endif
+        };
+
+        // The rename is the commit point of a rewrite, the directory entry has to reach the disk as well
+        void replace_file(const std::filesystem::path& from, const std::filesystem::path& to)
+        {
+#if defined(_WIN32)
+            if (!MoveFileExW(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH)) {
+                throw std::runtime_error("Failed to replace " + to.string());
+            }
+#else
+            std::filesystem::rename(from, to);
+            std::filesystem::path directoryPath = to.parent_path();
+            if (directoryPath.empty()) {
+                directoryPath = ".";
+            }
+            const int directory = ::open(directoryPath.c_str(), O_RDONLY);
+            if (directory >= 0) {
+                ::fsync(directory);
+                ::close(directory);
+            }
+#endif
+        }
+
+        // Readers of the container see either the old file or the new one, never a half written one
+        void write_container_file(const std::filesystem::path& container_path, const std::string& bytes)
+        {
+            std::filesystem::path temporaryPath = container_path;
+            temporaryPath += ".tmp";
+            {
+                append_file temporary(temporaryPath, true);
+                temporary.write(bytes);
+                temporary.sync();
+            }
+            replace_file(temporaryPath, container_path);
+        }
+
+        // Appends what an export writes to a string that keeps its capacity between saves
+        struct bytes_buffer : std::streambuf {
+            std::string bytes;
+
+            int_type overflow(const int_type c) override
+            {
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    bytes.push_back(traits_type::to_char_type(c));
+                }
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char* data, const std::streamsize count) override
+            {
+                bytes.append(data, static_cast<std::size_t>(count));
+                return count;
+            }
+        };
+
+        // Either records for the journal or a whole container that starts a new one
+        struct pending_write {
+            std::string bytes;
+            bool is_rewrite = false;
+            std::uint64_t container_hash = 0;
+        };
+
+    }
+
+    struct container_journal_impl {
+        ~container_journal_impl()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                is_running = false;
+            }
+            queued.notify_one();
+            writer.join();
+        }
+
+        void push(pending_write&& write)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (failure) {
+                    std::rethrow_exception(failure);
+                }
+                pending.push_back(std::move(write));
+                queued_count++;
+            }
+            queued.notify_one();
+        }
+
+        // Single writer, so records land in the order they were appended and a rewrite lands between the right ones
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                queued.wait(lock, [this] { return !is_running || !pending.empty(); });
+                if (pending.empty()) {
+                    return;
+                }
+
+                // Group commit, whatever gets appended within the window shares the sync of the first record
+                queued.wait_until(lock, last_sync + sync_window, [this] { return !is_running || is_flush_requested; });
+                std::vector<pending_write> batch = std::move(pending);
+                pending.clear();
+                const std::size_t batchCount = queued_count;
+                is_flush_requested = false;
+                lock.unlock();
+
+                try {
+                    write_batch(batch);
+                    sync_count.fetch_add(1, std::memory_order_relaxed);
+                } catch (...) {
+                    lock.lock();
+                    failure = std::current_exception();
+                    synced_count = queued_count; // nobody waits on records that will never land
+                    synced.notify_all();
+                    return;
+                }
+                last_sync = std::chrono::steady_clock::now();
+
+                lock.lock();
+                synced_count = batchCount;
+                synced.notify_all();
+            }
+        }
+
+        void write_batch(const std::vector<pending_write>& batch)
+        {
+            for (const pending_write& write : batch) {
+                if (!write.is_rewrite) {
+                    journal->write(write.bytes);
+                    continue;
+                }
+
+                // Records already written are part of the new container, the old journal can go without a sync
+                write_container_file(container_path, write.bytes);
+                journal.reset();
+                journal = std::make_unique<append_file>(get_journal_path(container_path), true);
+                journal->write(make_journal_header(write.container_hash));
+            }
+            journal->sync();
+        }
+
+        std::filesystem::path container_path;
+        std::chrono::milliseconds sync_window {};
+        symbol_table symbols; // of the records since the container was last written whole, callers serialize appends
+        std::size_t written_symbol_count = 1; // the empty symbol needs no record
+        std::unique_ptr<append_file> journal; // only the writer thread touches it once running
+        std::atomic<std::uintmax_t> container_bytes { 0 };
+        std::atomic<std::uintmax_t> journal_bytes { 0 };
+        std::atomic<std::size_t> sync_count { 0 };
+        std::mutex mutex;
+        std::condition_variable queued;
+        std::condition_variable synced;
+        std::vector<pending_write> pending;
+        std::size_t queued_count = 0;
+        std::size_t synced_count = 0;
+        bool is_flush_requested = false;
+        bool is_running = true;
+        std::exception_ptr failure;
+        std::chrono::steady_clock::time_point last_sync;
+        std::thread writer; // started last, once the journal is open
+    };
+
+    container_journal::container_journal(const std::filesystem::path& container_path, fmtdxc::project_container& container, const std::chrono::milliseconds sync_window)
+        : _impl(std::make_shared<container_journal_impl>())
+    {
+        const std::string containerBytes = read_file(container_path);
+        const std::uint64_t containerHash = hash_bytes(containerBytes.data(), containerBytes.size());
+        {
+            std::istringstream stream(containerBytes, std::ios::binary);
+            fmtdxc::version version;
+            fmtdxc::import_container(stream, container, version);
+        }
+
+        // Appending after a torn record would hide every later one, so the journal is cut back to the last whole record
+        const std::filesystem::path journalPath = get_journal_path(container_path);
+        const std::uintmax_t replayedBytes = replay_journal(journalPath, containerHash, container, _impl->symbols);
+        _impl->written_symbol_count = _impl->symbols.get_count();
+        if (replayedBytes) {
+            std::filesystem::resize_file(journalPath, replayedBytes);
+            _impl->journal = std::make_unique<append_file>(journalPath, false);
+            _impl->journal_bytes = replayedBytes - journal_header_size;
+        } else {
+            _impl->journal = std::make_unique<append_file>(journalPath, true);
+            _impl->journal->write(make_journal_header(containerHash));
+            _impl->journal->sync();
+        }
+        _impl->container_path = container_path;
+        _impl->sync_window = sync_window;
+        _impl->container_bytes = containerBytes.size();
+        _impl->writer = std::thread([impl = _impl.get()] { impl->run(); });
+    }
+
+    void container_journal::append_commit(const std::string& message, const fmtdxc::project& proj, const entity_changes& changes)
+    {
+        const commit_patch patch = make_commit_patch(message, proj, changes, _impl->symbols);
+        pending_write write;
+
+        // The names the commit interned go in a record of their own right before it, in the same write
+        symbols_record symbols { _impl->written_symbol_count, _impl->symbols.export_symbols(_impl->written_symbol_count) };
+        if (!symbols.texts.empty()) {
+            std::ostringstream symbolsPayload(std::ios::binary);
+            {
+                cereal::BinaryOutputArchive archive(symbolsPayload);
+                archive(record_type::symbols);
+                archive(symbols);
+            }
+            write.bytes = make_record(symbolsPayload.str());
+            _impl->written_symbol_count += symbols.texts.size();
+        }
+
+        std::ostringstream payload(std::ios::binary);
+        {
+            cereal::BinaryOutputArchive archive(payload);
+            archive(record_type::commit);
+            archive(patch);
+        }
+        write.bytes += make_record(payload.str());
+        _impl->journal_bytes += write.bytes.size();
+        _impl->push(std::move(write));
+    }
+
+    void container_journal::append_undo()
+    {
+        std::ostringstream payload(std::ios::binary);
+        {
+            cereal::BinaryOutputArchive archive(payload);
+            archive(record_type::undo);
+        }
+        pending_write write;
+        write.bytes = make_record(payload.str());
+        _impl->journal_bytes += write.bytes.size();
+        _impl->push(std::move(write));
+    }
+
+    void container_journal::append_redo()
+    {
+        std::ostringstream payload(std::ios::binary);
+        {
+            cereal::BinaryOutputArchive archive(payload);
+            archive(record_type::redo);
+        }
+        pending_write write;
+        write.bytes = make_record(payload.str());
+        _impl->journal_bytes += write.bytes.size();
+        _impl->push(std::move(write));
+    }
+
+    void container_journal::rewrite(const fmtdxc::project_container& container)
+    {
+        std::ostringstream stream(std::ios::binary);
+        fmtdxc::export_container(stream, container, fmtdxc::version::alpha);
+        pending_write write;
+        write.bytes = stream.str();
+        write.is_rewrite = true;
+        write.container_hash = hash_bytes(write.bytes.data(), write.bytes.size());
+        _impl->container_bytes = write.bytes.size();
+        _impl->journal_bytes = 0;
+        _impl->symbols = symbol_table(); // the next journal starts over, its records name their symbols again
+        _impl->written_symbol_count = 1;
+        _impl->push(std::move(write));
+    }
+
+    void container_journal::flush()
+    {
+        std::unique_lock<std::mutex> lock(_impl->mutex);
+        const std::size_t target = _impl->queued_count;
+        _impl->is_flush_requested = true;
+        _impl->queued.notify_one();
+        _impl->synced.wait(lock, [&] { return _impl->synced_count >= target; });
+        if (_impl->failure) {
+            std::rethrow_exception(_impl->failure);
+        }
+    }
+
+    std::uintmax_t container_journal::get_container_bytes() const
+    {
+        return _impl->container_bytes;
+    }
+
+    std::uintmax_t container_journal::get_journal_bytes() const
+    {
+        return _impl->journal_bytes;
+    }
+
+    std::size_t container_journal::get_sync_count() const
+    {
+        return _impl->sync_count.load(std::memory_order_relaxed);
+    }
+
+    commit_patch make_commit_patch(const std::string& message, const fmtdxc::project& proj, const entity_changes& changes, symbol_table& symbols)
+    {
+        commit_patch patch;
+        patch.message = message;
+        patch.name = symbols.intern(proj.name);
+        patch.ppq = proj.ppq;
+        patch.master_track_id = proj.master_track_id;
+        record_writes(proj.mixer_tracks, changes.mixer_tracks, symbols, patch.mixer_tracks);
+        record_writes(proj.audio_sequencers, changes.audio_sequencers, symbols, patch.audio_sequencers);
+        record_writes(proj.midi_sequencers, changes.midi_sequencers, symbols, patch.midi_sequencers);
+        return patch;
+    }
+
+    void apply_commit_patch(const commit_patch& patch, const symbol_table& symbols, fmtdxc::project_container& container)
+    {
+        fmtdxc::project proj = container.get_project();
+        proj.name = symbols.get_text(patch.name);
+        proj.ppq = patch.ppq;
+        proj.master_track_id = patch.master_track_id;
+        apply_writes(patch.mixer_tracks, symbols, proj.mixer_tracks);
+        apply_writes(patch.audio_sequencers, symbols, proj.audio_sequencers);
+        apply_writes(patch.midi_sequencers, symbols, proj.midi_sequencers);
+        container.commit(patch.message, proj);
+    }
+
+    void load_container(const std::filesystem::path& container_path, fmtdxc::project_container& container)
+    {
+        const std::string containerBytes = read_file(container_path);
+        {
+            std::istringstream stream(containerBytes, std::ios::binary);
+            fmtdxc::version version;
+            fmtdxc::import_container(stream, container, version);
+        }
+        symbol_table symbols;
+        replay_journal(get_journal_path(container_path), hash_bytes(containerBytes.data(), containerBytes.size()), container, symbols);
+    }
+
+    struct container_autosave_impl {
+        ~container_autosave_impl()
+        {
+            worker.reset(); // drops a save still waiting, the last changes are saved below either way
+            try {
+                save();
+            } catch (const std::exception& exception) {
+                std::cerr << "Last autosave failed: " << exception.what() << std::endl;
+            }
+        }
+
+        void notify()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                metrics.requested_count++;
+                if (!first_unsaved) {
+                    first_unsaved = std::chrono::steady_clock::now();
+                }
+            }
+            worker->post([this] { save(); });
+        }
+
+        // Covers every change notified before it starts, the ones notified while it runs post the next save
+        void save()
+        {
+            std::chrono::steady_clock::time_point since;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!first_unsaved) {
+                    return;
+                }
+                since = first_unsaved.value();
+                first_unsaved.reset();
+                saving_since = since;
+            }
+
+            const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            bytes_buffer& exported = buffers[1 - saved_buffer];
+            bool isWritten = false;
+            try {
+                exported.bytes.clear();
+                std::ostream stream(&exported);
+                export_callback(stream);
+                if (exported.bytes != buffers[saved_buffer].bytes) {
+                    write_container_file(container_path, exported.bytes);
+                    saved_buffer = 1 - saved_buffer;
+                    isWritten = true;
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                metrics.failed_count++;
+                saving_since.reset();
+                if (!first_unsaved || since < first_unsaved.value()) {
+                    first_unsaved = since; // still unsaved, the next save covers it
+                }
+                throw;
+            }
+            const std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            saving_since.reset();
+            if (isWritten) {
+                metrics.saved_count++;
+                metrics.last_bytes = buffers[saved_buffer].bytes.size();
+            } else {
+                metrics.skipped_count++;
+            }
+            metrics.last_lag = end - since;
+            metrics.max_lag = std::max(metrics.max_lag, metrics.last_lag);
+            metrics.last_save_duration = end - start;
+        }
+
+        std::filesystem::path container_path;
+        std::function<void(std::ostream&)> export_callback;
+        bytes_buffer buffers[2]; // the bytes last written and the ones of the next export, only the worker touches them
+        std::size_t saved_buffer = 0;
+        mutable std::mutex mutex;
+        autosave_metrics metrics;
+        std::optional<std::chrono::steady_clock::time_point> first_unsaved; // oldest change no save has started on
+        std::optional<std::chrono::steady_clock::time_point> saving_since; // oldest change the running save covers
+        std::optional<coalescing_worker> worker; // last, so that it stops before anything it saves from goes away
+    };
+
+    container_autosave::container_autosave(const std::filesystem::path& container_path, const std::function<void(std::ostream&)>& export_callback)
+        : _impl(std::make_shared<container_autosave_impl>())
+    {
+        if (!export_callback) {
+            throw std::invalid_argument("Export callback provided to container autosave is nullptr");
+        }
+        _impl->container_path = container_path;
+        _impl->export_callback = export_callback;
+        _impl->worker.emplace();
+    }
+
+    void container_autosave::notify()
+    {
+        _impl->notify();
+    }
+
+    autosave_metrics container_autosave::get_metrics() const
+    {
+        std::lock_guard<std::mutex> lock(_impl->mutex);
+        autosave_metrics metrics = _impl->metrics;
+        metrics.coalesced_count = _impl->worker->get_coalesced_count();
+        const std::optional<std::chrono::steady_clock::time_point> oldest = _impl->saving_since ? _impl->saving_since : _impl->first_unsaved;
+        metrics.is_dirty = oldest.has_value();
+        if (oldest) {
+            metrics.pending_lag = std::chrono::steady_clock::now() - oldest.value();
+        }
+        return metrics;
+    }
+
+}
+}
@@ -0,0 +1,201 @@
+#include <rtdxc/rtdxc.hpp>
+
+#include <deque>
+#include <mutex>
+#include <random>
+#include <shared_mutex>
+#include <stdexcept>
+
+namespace rtdxc {
+namespace detail {
+
+    struct symbol_table_impl {
+        symbol_table_impl()
+        {
+            std::random_device device;
+            id = (static_cast<std::uint64_t>(device()) << 32) ^ device();
+            append(std::string_view());
+        }
+
+        // Texts live in a deque so the views the index keys on stay valid as it grows
+        symbol append(const std::string_view text)
+        {
+            const symbol id = static_cast<symbol>(texts.size());
+            const std::string& stored = texts.emplace_back(text);
+            index.emplace(std::string_view(stored), id);
+            text_bytes += stored.size();
+            return id;
+        }
+
+        mutable std::shared_mutex mutex;
+        std::uint64_t id = 0;
+        std::deque<std::string> texts;
+        std::unordered_map<std::string_view, symbol> index;
+        std::size_t text_bytes = 0;
+    };
+
+    symbol_table::symbol_table()
+        : _impl(std::make_shared<symbol_table_impl>())
+    {
+    }
+
+    symbol symbol_table::intern(const std::string_view text)
+    {
+        {
+            std::shared_lock<std::shared_mutex> lock(_impl->mutex);
+            const auto it = _impl->index.find(text);
+            if (it != _impl->index.end()) {
+                return it->second;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(_impl->mutex);
+        const auto it = _impl->index.find(text);
+        return it != _impl->index.end() ? it->second : _impl->append(text);
+    }
+
+    std::optional<symbol> symbol_table::find(const std::string_view text) const
+    {
+        std::shared_lock<std::shared_mutex> lock(_impl->mutex);
+        const auto it = _impl->index.find(text);
+        if (it == _impl->index.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    const std::string& symbol_table::get_text(const symbol id) const
+    {
+        std::shared_lock<std::shared_mutex> lock(_impl->mutex);
+        if (id >= _impl->texts.size()) {
+            throw std::invalid_argument("Symbol provided to symbol table does not exist");
+        }
+        return _impl->texts[id];
+    }
+
+    std::uint64_t symbol_table::get_id() const
+    {
+        std::shared_lock<std::shared_mutex> lock(_impl->mutex);
+        return _impl->id;
+    }
+
+    std::size_t symbol_table::get_count() const
+    {
+        std::shared_lock<std::shared_mutex> lock(_impl->mutex);
+        return _impl->texts.size();
+    }
+
+    std::size_t symbol_table::get_text_bytes() const
+    {
+        std::shared_lock<std::shared_mutex> lock(_impl->mutex);
+        return _impl->text_bytes;
+    }
+
+    std::vector<std::string> symbol_table::export_symbols(const std::size_t first) const
+    {
+        std::shared_lock<std::shared_mutex> lock(_impl->mutex);
+        if (first >= _impl->texts.size()) {
+            return {};
+        }
+        return std::vector<std::string>(_impl->texts.begin() + first, _impl->texts.end());
+    }
+
+    void symbol_table::import_symbols(const std::size_t first, const std::vector<std::string>& texts)
+    {
+        std::unique_lock<std::shared_mutex> lock(_impl->mutex);
+        if (first > _impl->texts.size()) {
+            throw std::runtime_error("Symbols received for symbol table skip symbols it does not have yet");
+        }
+        for (std::size_t i = 0; i < texts.size(); ++i) {
+            const std::size_t id = first + i;
+            if (id < _impl->texts.size()) {
+                if (_impl->texts[id] != texts[i]) {
+                    throw std::runtime_error("Symbols received for symbol table diverge from the ones it has");
+                }
+            } else {
+                _impl->append(texts[i]);
+            }
+        }
+    }
+
+    void symbol_table::reset(const std::uint64_t id)
+    {
+        std::unique_lock<std::shared_mutex> lock(_impl->mutex);
+        _impl->id = id;
+        _impl->texts.clear();
+        _impl->index.clear();
+        _impl->text_bytes = 0;
+        _impl->append(std::string_view());
+    }
+
+    namespace {
+
+        // Calls visit on every name of the entity, in the order interned<entity_t>::names lists them
+        template <typename visit_t>
+        void for_each_name(fmtdxc::project::mixer_track& mt, const visit_t& visit)
+        {
+            visit(mt.name);
+        }
+
+        template <typename visit_t>
+        void for_each_name(fmtdxc::project::audio_clip& c, const visit_t& visit)
+        {
+            visit(c.name);
+        }
+
+        template <typename visit_t>
+        void for_each_name(fmtdxc::project::audio_sequencer& as, const visit_t& visit)
+        {
+            visit(as.name);
+            for (auto& [cid, c] : as.clips) {
+                for_each_name(c, visit);
+            }
+        }
+
+        template <typename visit_t>
+        void for_each_name(fmtdxc::project::midi_sequencer& ms, const visit_t& visit)
+        {
+            visit(ms.name);
+            visit(ms.instrument.name);
+        }
+
+    }
+
+    template <typename entity_t>
+    interned<entity_t> intern_names(const entity_t& entity, symbol_table& symbols)
+    {
+        interned<entity_t> result { entity, {} };
+        for_each_name(result.fields, [&](std::string& text) {
+            result.names.push_back(symbols.intern(text));
+            text.clear();
+        });
+        return result;
+    }
+
+    template <typename entity_t>
+    entity_t resolve_names(const interned<entity_t>& entity, const symbol_table& symbols)
+    {
+        entity_t result = entity.fields;
+        std::size_t index = 0;
+        for_each_name(result, [&](std::string& text) {
+            if (index == entity.names.size()) {
+                throw std::invalid_argument("Entity provided to name resolution has fewer names than its fields");
+            }
+            text = symbols.get_text(entity.names[index++]);
+        });
+        if (index != entity.names.size()) {
+            throw std::invalid_argument("Entity provided to name resolution has more names than its fields");
+        }
+        return result;
+    }
+
+    template interned<fmtdxc::project::mixer_track> intern_names(const fmtdxc::project::mixer_track&, symbol_table&);
+    template interned<fmtdxc::project::audio_sequencer> intern_names(const fmtdxc::project::audio_sequencer&, symbol_table&);
+    template interned<fmtdxc::project::audio_clip> intern_names(const fmtdxc::project::audio_clip&, symbol_table&);
+    template interned<fmtdxc::project::midi_sequencer> intern_names(const fmtdxc::project::midi_sequencer&, symbol_table&);
+    template fmtdxc::project::mixer_track resolve_names(const interned<fmtdxc::project::mixer_track>&, const symbol_table&);
+    template fmtdxc::project::audio_sequencer resolve_names(const interned<fmtdxc::project::audio_sequencer>&, const symbol_table&);
+    template fmtdxc::project::audio_clip resolve_names(const interned<fmtdxc::project::audio_clip>&, const symbol_table&);
+    template fmtdxc::project::midi_sequencer resolve_names(const interned<fmtdxc::project::midi_sequencer>&, const symbol_table&);
+
+}
+}
@@ -0,0 +1,996 @@
+#include <rtdxc/rtdxc.hpp>
+
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/optional.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/utility.hpp>
+#include <cereal/types/vector.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <streambuf>
+#include <thread>
+
+namespace rtdxc {
+namespace detail {
+
+    namespace {
+
+        enum struct wire_type : std::uint8_t {
+            join = 1, // C->H : request to join
+            join_container = 2, // H->C : full project_container blob (on join)
+            commit_request = 3, // C->H : client requests to commit (payload = message + optional diff)
+            commit_broadcast = 4, // H->* : authoritative commits from host, batched over the host's coalescing window
+            undo_broadcast = 7, // H->* : host performed undo
+            redo_broadcast = 8, // H->* : host performed redo
+            ping = 9, // keepalive if you want
+            symbols = 10, // H->* : symbols interned since the peer's last sync, sent before payloads that use them
+            join_commits = 11, // H->C : only the commits the client misses (on join)
+            chunk = 12, // *->* : bytes of a chunked transfer, join replies go this way
+            chunk_ack = 13, // *->* : bytes of a chunked transfer read so far
+        };
+
+        struct wire_peer {
+            std::string username;
+            daw_version version;
+
+            template <typename archive_t>
+            void serialize(archive_t& archive)
+            {
+                archive(username);
+                archive(version);
+            }
+        };
+
+        struct wire_join {
+            std::uint64_t commit_count = 0; // of the client, none means it wants the whole container
+            std::uint64_t commit_hash = 0; // identifies those commits, as the host hashed them
+            std::uint64_t symbol_table_id = 0; // of the table the client mirrors
+            std::uint64_t symbol_count = 0; // the client mirrors, the host only sends the ones after them
+
+            template <typename archive_t>
+            void serialize(archive_t& archive)
+            {
+                archive(commit_count);
+                archive(commit_hash);
+                archive(symbol_table_id);
+                archive(symbol_count);
+            }
+        };
+
+        struct wire_join_container {
+            fmtdxc::project_container container;
+            std::vector<std::uint64_t> commit_hashes;
+
+            template <typename archive_t>
+            void serialize(archive_t& archive)
+            {
+                archive(container);
+                archive(commit_hashes);
+            }
+        };
+
+        // Answers a join with only the commits the client misses, and carries the batches of commit_broadcast
+        struct wire_commits {
+            std::uint64_t first = 0; // commit count the patches follow, the one the client joined with
+            std::vector<commit_patch> patches;
+            std::uint64_t applied_count = 0;
+            std::vector<std::uint64_t> commit_hashes; // of the patches only, the client already holds the ones before
+
+            template <typename archive_t>
+            void serialize(archive_t& archive)
+            {
+                archive(first);
+                archive(patches);
+                archive(applied_count);
+                archive(commit_hashes);
+            }
+        };
+
+        struct wire_chunk {
+            std::uint64_t transfer_id = 0;
+            std::uint64_t offset = 0; // of bytes.front() in the transfer
+            std::uint64_t total = 0; // bytes of the whole transfer, 0 until the last chunk
+            bool is_last = false;
+            std::vector<std::uint8_t> bytes;
+
+            template <typename archive_t>
+            void serialize(archive_t& archive)
+            {
+                archive(transfer_id);
+                archive(offset);
+                archive(total);
+                archive(is_last);
+                archive(bytes);
+            }
+        };
+
+        struct wire_chunk_ack {
+            std::uint64_t transfer_id = 0;
+            std::uint64_t offset = 0; // every byte before it was read
+
+            template <typename archive_t>
+            void serialize(archive_t& archive)
+            {
+                archive(transfer_id);
+                archive(offset);
+            }
+        };
+
+        struct wire_symbols {
+            std::uint64_t table_id = 0; // a receiver mirroring another table starts over from the first symbol
+            std::uint64_t first = 0; // id of texts.front(), the receiver's table must already hold every symbol below it
+            std::vector<std::string> texts;
+
+            template <typename archive_t>
+            void serialize(archive_t& archive)
+            {
+                archive(table_id);
+                archive(first);
+                archive(texts);
+            }
+        };
+
+        struct wire_commit_request {
+            fmtdxc::project_commit commit;
+
+            template <typename archive_t>
+            void serialize(archive_t& archive)
+            {
+                archive(commit);
+            }
+        };
+
+        // Appends what cereal writes to a message
+        struct message_buffer : std::streambuf {
+            std::vector<std::uint8_t> bytes;
+
+            int_type overflow(const int_type c) override
+            {
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    bytes.push_back(static_cast<std::uint8_t>(traits_type::to_char_type(c)));
+                }
+                return traits_type::not_eof(c);
+            }
+
+            std::streamsize xsputn(const char* data, const std::streamsize count) override
+            {
+                bytes.insert(bytes.end(), data, data + count);
+                return count;
+            }
+        };
+
+        // Reads a message where it is, cereal never needs it copied
+        struct message_view_buffer : std::streambuf {
+            explicit message_view_buffer(const std::vector<std::uint8_t>& bytes)
+            {
+                char* data = const_cast<char*>(reinterpret_cast<const char*>(bytes.data()));
+                setg(data, data, data + bytes.size());
+            }
+        };
+
+        // A message is its type byte followed by the cereal bytes of its payload
+        template <typename payload_t>
+        void write_message(std::ostream& stream, const wire_type type, const payload_t& payload)
+        {
+            cereal::BinaryOutputArchive archive(stream);
+            archive(type);
+            archive(payload);
+        }
+
+        template <typename payload_t>
+        std::vector<std::uint8_t> encode(const wire_type type, const payload_t& payload)
+        {
+            message_buffer buffer;
+            std::ostream stream(&buffer);
+            write_message(stream, type, payload);
+            return std::move(buffer.bytes);
+        }
+
+        wire_type get_type(const std::vector<std::uint8_t>& message)
+        {
+            if (message.empty()) {
+                throw std::invalid_argument("Message provided to wire decoding is empty");
+            }
+            return static_cast<wire_type>(message.front());
+        }
+
+        template <typename payload_t>
+        payload_t decode(const std::vector<std::uint8_t>& message)
+        {
+            message_view_buffer buffer(message);
+            std::istream stream(&buffer);
+            cereal::BinaryInputArchive archive(stream);
+            wire_type type;
+            payload_t payload;
+            archive(type);
+            archive(payload);
+            return payload;
+        }
+
+        // False when the symbols skip some the mirror doesn't have, the payload that needs them tells the peer to join again
+        bool mirror_symbols(const wire_symbols& received, symbol_table& symbols)
+        {
+            if (received.table_id != symbols.get_id()) {
+                if (received.first != 0) {
+                    return false;
+                }
+                symbols.reset(received.table_id);
+            }
+            if (received.first > symbols.get_count()) {
+                return false;
+            }
+            symbols.import_symbols(received.first, received.texts);
+            return true;
+        }
+
+        // Whether the table holds every name of the patches, from held_count on
+        bool has_symbols(const wire_commits& commits, const std::size_t held_count, const symbol_table& symbols)
+        {
+            const std::size_t count = symbols.get_count();
+            const auto isKnown = [count](const auto& writes) {
+                return std::all_of(writes.begin(), writes.end(), [count](const auto& write) {
+                    return !write.second || std::all_of(write.second->names.begin(), write.second->names.end(), [count](const symbol name) { return name < count; });
+                });
+            };
+            return std::all_of(commits.patches.begin() + held_count, commits.patches.end(), [&](const commit_patch& patch) {
+                return patch.name < count && isKnown(patch.mixer_tracks) && isKnown(patch.audio_sequencers) && isKnown(patch.midi_sequencers);
+            });
+        }
+
+        // Resolves the names of every patch from held_count on, so that a malformed one throws before any of them is applied
+        void check_names(const wire_commits& commits, const std::size_t held_count, const symbol_table& symbols)
+        {
+            const auto check = [&symbols](const auto& writes) {
+                for (const auto& write : writes) {
+                    if (write.second) {
+                        (void)resolve_names(*write.second, symbols);
+                    }
+                }
+            };
+            for (std::size_t index = held_count; index < commits.patches.size(); ++index) {
+                check(commits.patches[index].mixer_tracks);
+                check(commits.patches[index].audio_sequencers);
+                check(commits.patches[index].midi_sequencers);
+            }
+        }
+
+        // Patches go over the commit at first + held_count, the commits past it are dropped by the first one applied and
+        // the applied count is restored once they are all in. Every patch is checked before the container is touched
+        void apply_commits(const wire_commits& commits, const std::size_t held_count, const symbol_table& symbols, fmtdxc::project_container& container, std::vector<std::uint64_t>& commit_hashes)
+        {
+            check_names(commits, held_count, symbols);
+            const std::size_t baseCount = commits.first + held_count;
+            while (container.get_applied_count() < baseCount) {
+                container.redo();
+            }
+            while (container.get_applied_count() > baseCount) {
+                container.undo();
+            }
+            for (std::size_t index = held_count; index < commits.patches.size(); ++index) {
+                apply_commit_patch(commits.patches[index], symbols, container);
+            }
+            while (container.get_applied_count() > commits.applied_count) {
+                container.undo();
+            }
+            commit_hashes.resize(baseCount + 1);
+            commit_hashes.insert(commit_hashes.end(), commits.commit_hashes.begin() + held_count, commits.commit_hashes.end());
+        }
+
+    }
+
+    std::vector<std::uint8_t> encode_join(const std::vector<std::uint64_t>& commit_hashes, const symbol_table& symbols)
+    {
+        wire_join join;
+        if (!commit_hashes.empty()) {
+            join.commit_count = commit_hashes.size() - 1;
+            join.commit_hash = commit_hashes.back();
+        }
+        join.symbol_table_id = symbols.get_id();
+        join.symbol_count = symbols.get_count();
+        return encode(wire_type::join, join);
+    }
+
+    std::vector<std::uint8_t> encode_join_reply(const std::vector<std::uint8_t>& join, const fmtdxc::project_container& container, const project_history& history, const std::vector<std::uint64_t>& commit_hashes)
+    {
+        message_buffer buffer;
+        std::ostream stream(&buffer);
+        write_join_reply(stream, join, container, history, commit_hashes);
+        return std::move(buffer.bytes);
+    }
+
+    bool apply_join_reply(const std::vector<std::uint8_t>& reply, fmtdxc::project_container& container, std::vector<std::uint64_t>& commit_hashes, symbol_table& symbols)
+    {
+        get_type(reply);
+        message_view_buffer buffer(reply);
+        std::istream stream(&buffer);
+        return apply_join_reply(stream, container, commit_hashes, symbols);
+    }
+
+    void write_join_reply(std::ostream& stream, const std::vector<std::uint8_t>& join, const fmtdxc::project_container& container, const project_history& history, const std::vector<std::uint64_t>& commit_hashes)
+    {
+        if (get_type(join) != wire_type::join) {
+            throw std::invalid_argument("Message provided to join reply is not a join");
+        }
+        const std::vector<fmtdxc::project_commit>& commits = container.get_commits();
+        if (commit_hashes.size() != commits.size() + 1) {
+            throw std::invalid_argument("Commit hashes provided to join reply do not cover the container commits");
+        }
+        const wire_join request = decode<wire_join>(join);
+
+        // The symbols the client doesn't mirror yet go first, the whole table when it mirrors another one
+        const symbol_table& symbols = history.get_symbols();
+        wire_symbols missingSymbols;
+        missingSymbols.table_id = symbols.get_id();
+        missingSymbols.first = request.symbol_table_id == missingSymbols.table_id ? std::min<std::uint64_t>(request.symbol_count, symbols.get_count()) : 0;
+        missingSymbols.texts = symbols.export_symbols(missingSymbols.first);
+        write_message(stream, wire_type::symbols, missingSymbols);
+
+        // The client's commits must be a prefix of ours, and every commit after them still in the history
+        const bool isPrefix = request.commit_count > 0
+            && request.commit_count <= commits.size()
+            && commit_hashes[request.commit_count] == request.commit_hash;
+        const bool isCovered = request.commit_count >= history.get_first_index()
+            && history.get_last_index() == commits.size();
+        if (!isPrefix || !isCovered) {
+            cereal::BinaryOutputArchive archive(stream); // the fields of wire_join_container, without copying the container into one
+            archive(wire_type::join_container);
+            archive(container);
+            archive(commit_hashes);
+            return;
+        }
+
+        wire_commits reply;
+        reply.first = request.commit_count;
+        reply.applied_count = container.get_applied_count();
+        reply.patches.reserve(commits.size() - request.commit_count);
+        for (std::size_t index = request.commit_count + 1; index <= commits.size(); ++index) {
+            reply.patches.push_back(history.get_commit_patch(index, commits[index - 1].message));
+        }
+        reply.commit_hashes.assign(commit_hashes.begin() + request.commit_count + 1, commit_hashes.end());
+        write_message(stream, wire_type::join_commits, reply);
+    }
+
+    bool apply_join_reply(std::istream& reply, fmtdxc::project_container& container, std::vector<std::uint64_t>& commit_hashes, symbol_table& symbols)
+    {
+        cereal::BinaryInputArchive archive(reply);
+        wire_type type;
+        archive(type);
+        if (type != wire_type::symbols) {
+            throw std::invalid_argument("Message provided to join reply application does not start with symbols");
+        }
+        wire_symbols missingSymbols;
+        archive(missingSymbols);
+        if (!mirror_symbols(missingSymbols, symbols)) {
+            throw std::invalid_argument("Message provided to join reply application does not follow the symbols of the table");
+        }
+
+        archive(type);
+        if (type == wire_type::join_container) {
+            wire_join_container whole;
+            archive(whole);
+            container = std::move(whole.container);
+            commit_hashes = std::move(whole.commit_hashes);
+            return true;
+        }
+        if (type != wire_type::join_commits) {
+            throw std::invalid_argument("Message provided to join reply application is not a join reply");
+        }
+
+        wire_commits missing;
+        archive(missing);
+        const std::size_t commitCount = container.get_commits().size();
+        if (missing.first != commitCount || commit_hashes.size() != commitCount + 1) {
+            throw std::invalid_argument("Message provided to join reply application does not follow the commits of the container");
+        }
+        if (missing.patches.size() != missing.commit_hashes.size() || missing.applied_count > commitCount + missing.patches.size() || !has_symbols(missing, 0, symbols)) {
+            throw std::invalid_argument("Message provided to join reply application is malformed");
+        }
+
+        apply_commits(missing, 0, symbols, container, commit_hashes);
+        return false;
+    }
+
+    // Commits wait in pending until the window of the first one passed, sends hold send_mutex from taking a batch to
+    // broadcasting it so that flush and the batcher thread never reorder two batches
+    struct commit_batcher_impl {
+        commit_batcher_impl(const std::function<void(const std::vector<std::uint8_t>&)>& broadcast, const std::chrono::milliseconds batch_window, const std::size_t max_count)
+            : broadcast_callback(broadcast)
+            , window(batch_window)
+            , max_commit_count(max_count)
+            , worker([this] { run(); })
+        {
+        }
+
+        ~commit_batcher_impl()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                is_running = false;
+            }
+            pushed.notify_one();
+            worker.join();
+        }
+
+        void push(const commit_patch& patch, const std::vector<std::uint64_t>& commit_hashes, const std::size_t applied_count, const symbol_table& symbols)
+        {
+            if (commit_hashes.size() < 2 || applied_count >= commit_hashes.size()) {
+                throw std::invalid_argument("Commit hashes provided to commit batcher do not cover a commit");
+            }
+            const std::size_t commitCount = commit_hashes.size() - 1;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (pending.patches.empty()) {
+                    pending.first = commitCount - 1;
+                    first_pushed = std::chrono::steady_clock::now();
+                } else if (pending.first + pending.patches.size() + 1 != commitCount) {
+                    throw std::invalid_argument("Commit hashes provided to commit batcher do not follow the batched commits");
+                }
+                pending.patches.push_back(patch);
+                pending.commit_hashes.push_back(commit_hashes.back());
+                pending.applied_count = applied_count;
+
+                // The first batch carries the whole table, clients that joined already hold its start and check it matches
+                if (symbols.get_id() != pending_symbols.table_id) {
+                    pending_symbols = wire_symbols { symbols.get_id(), 0, {} };
+                    synced_symbol_count = 0;
+                }
+                std::vector<std::string> texts = symbols.export_symbols(synced_symbol_count);
+                if (pending_symbols.texts.empty()) {
+                    pending_symbols.first = synced_symbol_count;
+                }
+                synced_symbol_count += texts.size();
+                pending_symbols.texts.insert(pending_symbols.texts.end(), std::make_move_iterator(texts.begin()), std::make_move_iterator(texts.end()));
+            }
+            pushed.notify_one();
+        }
+
+        void broadcast_pending()
+        {
+            std::lock_guard<std::mutex> sendLock(send_mutex);
+            wire_commits batch;
+            wire_symbols symbols;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (pending.patches.empty()) {
+                    return;
+                }
+                batch = std::move(pending);
+                pending = wire_commits {};
+                symbols.table_id = pending_symbols.table_id;
+                symbols.first = pending_symbols.first;
+                symbols.texts = std::move(pending_symbols.texts);
+                pending_symbols.texts.clear();
+            }
+            if (batch.patches.size() > 1) {
+                batched_count.fetch_add(batch.patches.size(), std::memory_order_relaxed);
+            }
+            if (!symbols.texts.empty()) {
+                broadcast_callback(encode(wire_type::symbols, symbols));
+            }
+            broadcast_callback(encode(wire_type::commit_broadcast, batch));
+        }
+
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                pushed.wait(lock, [this] { return !is_running || !pending.patches.empty(); });
+                pushed.wait_until(lock, first_pushed + window, [this] { return !is_running || pending.patches.empty() || pending.patches.size() >= max_commit_count; });
+                if (!is_running) {
+                    return;
+                }
+                lock.unlock();
+
+                // A failed broadcast must not take the batcher down, the client that misses the batch joins again
+                try {
+                    broadcast_pending();
+                } catch (const std::exception& exception) {
+                    std::cerr << "Commit broadcast failed: " << exception.what() << std::endl;
+                }
+                lock.lock();
+            }
+        }
+
+        std::function<void(const std::vector<std::uint8_t>&)> broadcast_callback;
+        std::chrono::milliseconds window;
+        std::size_t max_commit_count;
+        std::mutex send_mutex;
+        std::mutex mutex;
+        std::condition_variable pushed;
+        wire_commits pending;
+        wire_symbols pending_symbols; // interned since the last batch, broadcast right before it
+        std::size_t synced_symbol_count = 0;
+        std::chrono::steady_clock::time_point first_pushed;
+        bool is_running = true;
+        std::atomic<std::size_t> batched_count { 0 };
+        std::thread worker; // last so that it starts once everything above is constructed
+    };
+
+    commit_batcher::commit_batcher(const std::function<void(const std::vector<std::uint8_t>&)>& broadcast_callback, const std::chrono::milliseconds window, const std::size_t max_commit_count)
+    {
+        if (!max_commit_count) {
+            throw std::invalid_argument("Max commit count provided to commit batcher is zero");
+        }
+        _impl = std::make_shared<commit_batcher_impl>(broadcast_callback, window, max_commit_count);
+    }
+
+    void commit_batcher::push(const commit_patch& patch, const std::vector<std::uint64_t>& commit_hashes, const std::size_t applied_count, const symbol_table& symbols)
+    {
+        _impl->push(patch, commit_hashes, applied_count, symbols);
+    }
+
+    void commit_batcher::flush()
+    {
+        _impl->broadcast_pending();
+    }
+
+    std::size_t commit_batcher::get_batched_count() const
+    {
+        return _impl->batched_count.load(std::memory_order_relaxed);
+    }
+
+    bool apply_symbols(const std::vector<std::uint8_t>& message, symbol_table& symbols)
+    {
+        if (get_type(message) != wire_type::symbols) {
+            return false;
+        }
+        mirror_symbols(decode<wire_symbols>(message), symbols); // after a gap the batch that needs the missing symbols fails instead
+        return true;
+    }
+
+    bool apply_commit_broadcast(const std::vector<std::uint8_t>& message, fmtdxc::project_container& container, std::vector<std::uint64_t>& commit_hashes, const symbol_table& symbols)
+    {
+        if (get_type(message) != wire_type::commit_broadcast) {
+            throw std::invalid_argument("Message provided to commit broadcast application is not a commit broadcast");
+        }
+        const wire_commits batch = decode<wire_commits>(message);
+        if (batch.patches.empty() || batch.patches.size() != batch.commit_hashes.size() || batch.applied_count > batch.first + batch.patches.size()) {
+            throw std::invalid_argument("Message provided to commit broadcast application is malformed");
+        }
+        const std::size_t commitCount = container.get_commits().size();
+        if (commit_hashes.size() != commitCount + 1) {
+            throw std::invalid_argument("Commit hashes provided to commit broadcast application do not cover the container commits");
+        }
+        if (batch.first > commitCount) {
+            return false;
+        }
+
+        // The host committed the batch over its applied commits, the ones the client has past them are a redo tail the
+        // batch drops. A join reply sent while the batch was pending already applied its first commits, they must be the host's
+        const std::size_t appliedCount = container.get_applied_count();
+        if (appliedCount < batch.first) {
+            return false;
+        }
+        const std::size_t heldCount = std::min<std::size_t>(appliedCount - batch.first, batch.patches.size());
+        if (heldCount && commit_hashes[batch.first + heldCount] != batch.commit_hashes[heldCount - 1]) {
+            return false;
+        }
+        if (!has_symbols(batch, heldCount, symbols)) {
+            return false; // the client missed the symbols sent ahead of the batch
+        }
+        if (heldCount < batch.patches.size()) {
+            apply_commits(batch, heldCount, symbols, container, commit_hashes);
+        }
+        return true;
+    }
+
+    // One transfer at a time, its writer thread only gets a window of chunks ahead of the last acknowledgement
+    struct chunk_sender_impl {
+        // Hands every chunk_size bytes written to the sender, the writer waits there when the window is full. A chunk only
+        // leaves on overflow once the next byte is written, so the one finish sends is the last
+        struct chunk_buffer : std::streambuf {
+            explicit chunk_buffer(chunk_sender_impl& owner)
+                : sender(owner)
+                , bytes(owner.chunk_size)
+            {
+                setp(bytes.data(), bytes.data() + bytes.size());
+            }
+
+            int_type overflow(const int_type c) override
+            {
+                sender.push_chunk(pbase(), pptr(), false);
+                setp(bytes.data(), bytes.data() + bytes.size());
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    *pptr() = traits_type::to_char_type(c);
+                    pbump(1);
+                }
+                return traits_type::not_eof(c);
+            }
+
+            void finish()
+            {
+                sender.push_chunk(pbase(), pptr(), true); // empty for an empty transfer, it still starts and ends the receiver
+            }
+
+            chunk_sender_impl& sender;
+            std::vector<char> bytes;
+        };
+
+        struct sent_chunk {
+            std::uint64_t end = 0; // offset past its last byte
+            std::vector<std::uint8_t> message;
+        };
+
+        chunk_sender_impl(const std::function<void(const std::vector<std::uint8_t>&)>& send, const std::size_t chunk, const std::size_t window)
+            : send_callback(send)
+            , chunk_size(chunk)
+            , window_size(window)
+        {
+            // Receivers take a new id for a new transfer, so that a sender created again doesn't look like the one before
+            std::random_device device;
+            transfer_id = std::uniform_int_distribution<std::uint64_t>()(device);
+        }
+
+        ~chunk_sender_impl()
+        {
+            stop();
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                is_stopping = true;
+            }
+            condition.notify_all();
+            if (writer.joinable()) {
+                writer.join();
+            }
+        }
+
+        void run_writer(const std::function<void(std::ostream&)>& write_callback)
+        {
+            try {
+                chunk_buffer buffer(*this);
+                std::ostream stream(&buffer);
+                stream.exceptions(std::ios::badbit); // so that an abandoned transfer leaves the write callback at once
+                write_callback(stream);
+                buffer.finish();
+                std::lock_guard<std::mutex> lock(mutex);
+                is_written = true;
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!is_stopping) {
+                    error = std::current_exception();
+                }
+            }
+            condition.notify_all();
+        }
+
+        void push_chunk(const char* begin, const char* end, const bool is_last)
+        {
+            const std::uint64_t size = static_cast<std::uint64_t>(end - begin);
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this, size] { return is_stopping || produced + size - acked <= window_size; });
+            if (is_stopping) {
+                throw std::runtime_error("Chunk sender abandoned the transfer");
+            }
+            wire_chunk chunk;
+            chunk.transfer_id = transfer_id;
+            chunk.offset = produced;
+            chunk.is_last = is_last;
+            chunk.bytes.assign(begin, end);
+            produced += size;
+            if (is_last) {
+                total = produced;
+                chunk.total = total;
+            }
+            sent_chunks.push_back({ produced, encode(wire_type::chunk, chunk) });
+            send_callback(sent_chunks.back().message); // under the lock, so that a resume never reorders chunks
+        }
+
+        std::function<void(const std::vector<std::uint8_t>&)> send_callback;
+        std::size_t chunk_size;
+        std::size_t window_size;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::uint64_t transfer_id = 0;
+        bool is_started = false;
+        bool is_stopping = false;
+        bool is_written = false;
+        std::uint64_t total = 0; // 0 until the last chunk
+        std::uint64_t produced = 0;
+        std::uint64_t acked = 0;
+        std::deque<sent_chunk> sent_chunks; // not acknowledged yet
+        std::exception_ptr error;
+        std::shared_ptr<const std::function<void(const transfer_progress&)>> progress_callback;
+        std::thread writer;
+    };
+
+    chunk_sender::chunk_sender(const std::function<void(const std::vector<std::uint8_t>&)>& send_callback, const std::size_t chunk_size, const std::size_t window_size)
+    {
+        if (!chunk_size || !window_size) {
+            throw std::invalid_argument("Sizes provided to chunk sender must not be 0");
+        }
+        if (chunk_size > window_size) {
+            throw std::invalid_argument("Window size provided to chunk sender must hold at least one chunk");
+        }
+        _impl = std::make_shared<chunk_sender_impl>(send_callback, chunk_size, window_size);
+    }
+
+    std::uint64_t chunk_sender::start(const std::function<void(std::ostream&)>& write_callback)
+    {
+        _impl->stop();
+        std::lock_guard<std::mutex> lock(_impl->mutex);
+        ++_impl->transfer_id;
+        _impl->is_started = true;
+        _impl->is_stopping = false;
+        _impl->is_written = false;
+        _impl->total = 0;
+        _impl->produced = 0;
+        _impl->acked = 0;
+        _impl->sent_chunks.clear();
+        _impl->error = nullptr;
+        _impl->writer = std::thread([impl = _impl.get(), write_callback] { impl->run_writer(write_callback); });
+        return _impl->transfer_id;
+    }
+
+    void chunk_sender::resume()
+    {
+        std::lock_guard<std::mutex> lock(_impl->mutex);
+        for (const auto& chunk : _impl->sent_chunks) {
+            _impl->send_callback(chunk.message);
+        }
+    }
+
+    bool chunk_sender::receive(const std::vector<std::uint8_t>& message)
+    {
+        if (message.empty() || get_type(message) != wire_type::chunk_ack) {
+            return false;
+        }
+        const wire_chunk_ack ack = decode<wire_chunk_ack>(message);
+        transfer_progress progress;
+        std::shared_ptr<const std::function<void(const transfer_progress&)>> callback;
+        {
+            std::lock_guard<std::mutex> lock(_impl->mutex);
+            if (ack.transfer_id != _impl->transfer_id || ack.offset <= _impl->acked || ack.offset > _impl->produced) {
+                return true; // of an abandoned transfer, or repeated after a resume
+            }
+            _impl->acked = ack.offset;
+            while (!_impl->sent_chunks.empty() && _impl->sent_chunks.front().end <= _impl->acked) {
+                _impl->sent_chunks.pop_front();
+            }
+            progress = { _impl->transfer_id, _impl->acked, _impl->total };
+            callback = _impl->progress_callback;
+        }
+        _impl->condition.notify_all();
+        if (callback) {
+            (*callback)(progress);
+        }
+        return true;
+    }
+
+    void chunk_sender::wait()
+    {
+        std::unique_lock<std::mutex> lock(_impl->mutex);
+        _impl->condition.wait(lock, [this] {
+            return !_impl->is_started || _impl->error || (_impl->is_written && _impl->acked == _impl->total);
+        });
+        if (_impl->error) {
+            std::rethrow_exception(_impl->error);
+        }
+    }
+
+    void chunk_sender::on_progress(const std::function<void(const transfer_progress&)>& progress_callback)
+    {
+        std::lock_guard<std::mutex> lock(_impl->mutex);
+        _impl->progress_callback = std::make_shared<const std::function<void(const transfer_progress&)>>(progress_callback);
+    }
+
+    // Chunks wait in a queue until the reader thread gets to them, they are acknowledged once it moves past them
+    struct chunk_receiver_impl {
+        // Blocks the read callback until the next chunk arrives
+        struct chunk_buffer : std::streambuf {
+            explicit chunk_buffer(chunk_receiver_impl& owner)
+                : receiver(owner)
+            {
+            }
+
+            int_type underflow() override
+            {
+                if (!receiver.next_chunk(bytes)) {
+                    return traits_type::eof();
+                }
+                char* data = reinterpret_cast<char*>(bytes.data());
+                setg(data, data, data + bytes.size());
+                return traits_type::to_int_type(*gptr());
+            }
+
+            chunk_receiver_impl& receiver;
+            std::vector<std::uint8_t> bytes;
+        };
+
+        chunk_receiver_impl(const std::function<void(const std::vector<std::uint8_t>&)>& send, const std::function<void(std::istream&)>& read)
+            : send_callback(send)
+            , read_callback(read)
+        {
+        }
+
+        ~chunk_receiver_impl()
+        {
+            stop();
+        }
+
+        void stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                is_stopping = true;
+            }
+            condition.notify_all();
+            if (reader.joinable()) {
+                reader.join();
+            }
+        }
+
+        // Under the lock, so that acknowledgements leave in the order of their offsets
+        void acknowledge()
+        {
+            send_callback(encode(wire_type::chunk_ack, wire_chunk_ack { transfer_id, read_offset }));
+        }
+
+        void report_read(const std::uint64_t count)
+        {
+            transfer_progress progress;
+            std::shared_ptr<const std::function<void(const transfer_progress&)>> callback;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                read_offset += count;
+                acknowledge();
+                progress = { transfer_id, read_offset, total };
+                callback = progress_callback;
+            }
+            if (callback) {
+                (*callback)(progress);
+            }
+        }
+
+        [[nodiscard]] bool next_chunk(std::vector<std::uint8_t>& bytes)
+        {
+            if (!bytes.empty()) {
+                report_read(bytes.size());
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return is_stopping || !chunks.empty() || is_received; });
+            if (is_stopping || chunks.empty()) {
+                return false;
+            }
+            bytes = std::move(chunks.front());
+            chunks.pop_front();
+            return true;
+        }
+
+        void run_reader()
+        {
+            std::exception_ptr readError;
+            try {
+                chunk_buffer buffer(*this);
+                std::istream stream(&buffer);
+                read_callback(stream);
+            } catch (...) {
+                readError = std::current_exception();
+            }
+            transfer_progress progress;
+            std::shared_ptr<const std::function<void(const transfer_progress&)>> callback;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (is_stopping) {
+                    return;
+                }
+                // Whatever the callback left unread counts as read, and so do the chunks still to come, the sender would
+                // otherwise wait on them forever
+                chunks.clear();
+                read_offset = received_offset;
+                acknowledge();
+                error = readError;
+                is_read = true;
+                progress = { transfer_id, read_offset, total };
+                callback = progress_callback;
+            }
+            condition.notify_all();
+            if (callback) {
+                (*callback)(progress);
+            }
+        }
+
+        std::function<void(const std::vector<std::uint8_t>&)> send_callback;
+        std::function<void(std::istream&)> read_callback;
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::uint64_t transfer_id = 0;
+        bool is_started = false;
+        bool is_stopping = false;
+        bool is_read = false;
+        bool is_received = false; // the last chunk arrived
+        std::uint64_t total = 0; // 0 until the last chunk
+        std::uint64_t received_offset = 0;
+        std::uint64_t read_offset = 0;
+        std::deque<std::vector<std::uint8_t>> chunks; // received, not read yet
+        std::exception_ptr error;
+        std::shared_ptr<const std::function<void(const transfer_progress&)>> progress_callback;
+        std::thread reader;
+    };
+
+    chunk_receiver::chunk_receiver(const std::function<void(const std::vector<std::uint8_t>&)>& send_callback, const std::function<void(std::istream&)>& read_callback)
+        : _impl(std::make_shared<chunk_receiver_impl>(send_callback, read_callback))
+    {
+    }
+
+    bool chunk_receiver::receive(const std::vector<std::uint8_t>& message)
+    {
+        if (message.empty() || get_type(message) != wire_type::chunk) {
+            return false;
+        }
+        wire_chunk chunk = decode<wire_chunk>(message);
+        std::unique_lock<std::mutex> lock(_impl->mutex);
+        if (!_impl->is_started || chunk.transfer_id != _impl->transfer_id) {
+            if (chunk.offset) {
+                return true; // rest of a transfer abandoned by either side
+            }
+            lock.unlock();
+            _impl->stop();
+            lock.lock();
+            _impl->transfer_id = chunk.transfer_id;
+            _impl->is_started = true;
+            _impl->is_stopping = false;
+            _impl->is_read = false;
+            _impl->is_received = false;
+            _impl->total = 0;
+            _impl->received_offset = 0;
+            _impl->read_offset = 0;
+            _impl->chunks.clear();
+            _impl->error = nullptr;
+            _impl->reader = std::thread([impl = _impl.get()] { impl->run_reader(); });
+        }
+        if (chunk.offset > _impl->received_offset) {
+            return true; // sent on after a rebind, the sender resumes before it
+        }
+        const std::uint64_t known = _impl->received_offset - chunk.offset;
+        if (known >= chunk.bytes.size() && (_impl->is_received || !chunk.is_last)) {
+            _impl->acknowledge(); // sent again on resume, the acknowledgement it answers may be lost
+            return true;
+        }
+        if (known < chunk.bytes.size()) {
+            chunk.bytes.erase(chunk.bytes.begin(), chunk.bytes.begin() + static_cast<std::ptrdiff_t>(known));
+            _impl->received_offset += chunk.bytes.size();
+            _impl->chunks.push_back(std::move(chunk.bytes));
+        }
+        if (chunk.is_last) {
+            _impl->is_received = true;
+            _impl->total = _impl->received_offset;
+        }
+        if (_impl->is_read) {
+            _impl->chunks.clear(); // the read callback already returned
+            _impl->read_offset = _impl->received_offset;
+            _impl->acknowledge();
+        }
+        lock.unlock();
+        _impl->condition.notify_all();
+        return true;
+    }
+
+    void chunk_receiver::wait()
+    {
+        std::unique_lock<std::mutex> lock(_impl->mutex);
+        _impl->condition.wait(lock, [this] { return _impl->is_read; });
+        if (_impl->error) {
+            std::rethrow_exception(_impl->error);
+        }
+    }
+
+    void chunk_receiver::on_progress(const std::function<void(const transfer_progress&)>& progress_callback)
+    {
+        std::lock_guard<std::mutex> lock(_impl->mutex);
+        _impl->progress_callback = std::make_shared<const std::function<void(const transfer_progress&)>>(progress_callback);
+    }
+
+}
+}
@@ -0,0 +1,221 @@
+#include <rtdxc/rtdxc.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace rtdxc {
+namespace detail {
+
+    struct coalescing_worker_impl {
+        coalescing_worker_impl()
+            : worker([this] { run(); })
+        {
+        }
+
+        ~coalescing_worker_impl()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                is_running = false;
+            }
+            posted.notify_one();
+            worker.join();
+        }
+
+        void post(const std::function<void()>& task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (pending) {
+                    coalesced_count.fetch_add(1, std::memory_order_relaxed);
+                }
+                pending = task;
+            }
+            posted.notify_one();
+        }
+
+        void run()
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                posted.wait(lock, [this] { return !is_running || pending; });
+                if (!is_running) {
+                    return;
+                }
+                std::function<void()> task = std::move(pending);
+                pending = nullptr;
+                lock.unlock();
+
+                // A failed task must not take the worker down, the next post gets a fresh try
+                try {
+                    task();
+                } catch (const std::exception& exception) {
+                    std::cerr << "Session worker task failed: " << exception.what() << std::endl;
+                }
+                lock.lock();
+            }
+        }
+
+        mutable std::mutex mutex;
+        std::condition_variable posted;
+        std::function<void()> pending;
+        bool is_running = true;
+        std::atomic<std::size_t> coalesced_count { 0 };
+        std::thread worker; // last so that it starts once everything above is constructed
+    };
+
+    coalescing_worker::coalescing_worker()
+        : _impl(std::make_shared<coalescing_worker_impl>())
+    {
+    }
+
+    void coalescing_worker::post(const std::function<void()>& task)
+    {
+        _impl->post(task);
+    }
+
+    bool coalescing_worker::is_pending() const
+    {
+        std::lock_guard<std::mutex> lock(_impl->mutex);
+        return static_cast<bool>(_impl->pending);
+    }
+
+    std::size_t coalescing_worker::get_coalesced_count() const
+    {
+        return _impl->coalesced_count.load(std::memory_order_relaxed);
+    }
+
+
+    struct worker_pool_impl {
+        worker_pool_impl(const std::size_t thread_count)
+        {
+            const std::size_t threadCount = thread_count ? thread_count : std::max(1u, std::thread::hardware_concurrency());
+            workers.reserve(threadCount - 1);
+            // A thread the system refuses to start leaves the pool smaller, the started ones are still joined by the destructor
+            try {
+                for (std::size_t i = 1; i < threadCount; ++i) {
+                    workers.emplace_back([this] { run_worker(); });
+                }
+            } catch (const std::system_error& exception) {
+                std::cerr << "Worker pool started " << workers.size() + 1 << " of " << threadCount << " threads: " << exception.what() << std::endl;
+            }
+        }
+
+        ~worker_pool_impl()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                is_running = false;
+            }
+            posted.notify_all();
+            for (std::thread& worker : workers) {
+                worker.join();
+            }
+        }
+
+        void run(const std::size_t count, const std::function<void(std::size_t)>& task)
+        {
+            std::lock_guard<std::mutex> runLock(run_mutex);
+            if (workers.empty() || count <= 1) {
+                for (std::size_t i = 0; i < count; ++i) {
+                    task(i);
+                }
+                return;
+            }
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job = &task;
+                job_count = count;
+                next = 0;
+                error = nullptr;
+                active_count = workers.size();
+                generation++;
+            }
+            posted.notify_all();
+            work();
+
+            // Every worker checks in before the job goes out of scope, a late one would otherwise read a dead task
+            std::unique_lock<std::mutex> lock(mutex);
+            finished.wait(lock, [this] { return active_count == 0; });
+            job = nullptr;
+            if (error) {
+                std::rethrow_exception(std::exchange(error, nullptr));
+            }
+        }
+
+        // Indices are pulled one at a time so big tracks don't stall a chunk
+        void work()
+        {
+            for (std::size_t i = next++; i < job_count; i = next++) {
+                try {
+                    (*job)(i);
+                } catch (...) {
+                    std::lock_guard<std::mutex> lock(error_mutex);
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                    next = job_count;
+                }
+            }
+        }
+
+        void run_worker()
+        {
+            std::size_t seenGeneration = 0;
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                posted.wait(lock, [&] { return !is_running || generation != seenGeneration; });
+                if (!is_running) {
+                    return;
+                }
+                seenGeneration = generation;
+                lock.unlock();
+                work();
+                lock.lock();
+                if (--active_count == 0) {
+                    finished.notify_one();
+                }
+            }
+        }
+
+        std::mutex run_mutex; // one loop at a time
+        std::mutex mutex;
+        std::mutex error_mutex;
+        std::condition_variable posted;
+        std::condition_variable finished;
+        const std::function<void(std::size_t)>* job = nullptr;
+        std::size_t job_count = 0;
+        std::atomic<std::size_t> next { 0 };
+        std::exception_ptr error;
+        std::size_t active_count = 0;
+        std::size_t generation = 0;
+        bool is_running = true;
+        std::vector<std::thread> workers; // last so that they start once everything above is constructed
+    };
+
+    worker_pool::worker_pool(const std::size_t thread_count)
+        : _impl(std::make_shared<worker_pool_impl>(thread_count))
+    {
+    }
+
+    void worker_pool::run(const std::size_t count, const std::function<void(std::size_t)>& task)
+    {
+        _impl->run(count, task);
+    }
+
+    std::size_t worker_pool::get_thread_count() const
+    {
+        return _impl->workers.size() + 1;
+    }
+
+}
+}
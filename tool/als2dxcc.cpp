@@ -1,46 +1,115 @@
 #include <rtdxc/rtdxc.hpp>
 
+#include <chrono>
 #include <fstream>
+#include <mutex>
 
-int main(int argc, char* argv[])
+namespace {
+
+void print_usage()
+{
+    std::cout << "Usage: als2dxcc <input.als> [output.dxcc]" << std::endl;
+    std::cout << "       als2dxcc [--jobs N] <input directory> [collection directory]" << std::endl;
+}
+
+int convert_directory(const std::filesystem::path& input_directory_path, const std::filesystem::path& collection_directory_path, const std::size_t job_count)
+{
+    const std::vector<std::filesystem::path> _als_paths = rtdxc::find_als_sets(input_directory_path);
+
+    std::mutex _output_mutex;
+    std::size_t _done_count = 0;
+    rtdxc::import_options _options;
+    _options.job_count = job_count;
+    _options.progress_callback = [&](const rtdxc::import_result& _result) {
+        std::lock_guard<std::mutex> _lock(_output_mutex);
+        _done_count++;
+        if (_result.error) {
+            std::cerr << "Error: " << _result.als_path << ": " << _result.error.value() << std::endl;
+        } else {
+            std::cout << "[" << _done_count << "/" << _als_paths.size() << "] " << _result.dxcc_path.filename() << std::endl;
+        }
+    };
+
+    const auto _start = std::chrono::steady_clock::now();
+    const std::vector<rtdxc::import_result> _results = rtdxc::import_many(_als_paths, collection_directory_path, _options);
+    const double _seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - _start).count();
+
+    std::size_t _failed_count = 0;
+    std::uintmax_t _total_bytes = 0;
+    for (const rtdxc::import_result& _result : _results) {
+        _failed_count += _result.error ? 1 : 0;
+        _total_bytes += _result.als_bytes;
+    }
+    const double _megabytes = static_cast<double>(_total_bytes) / (1024. * 1024.);
+    std::cout << _results.size() - _failed_count << " sets imported, " << _failed_count << " failed in " << _seconds << " s ("
+              << static_cast<double>(_results.size()) / _seconds << " files/s, "
+              << _megabytes / _seconds << " MB/s)" << std::endl;
+    return _failed_count ? 3 : 0;
+}
+
+int convert_file(const std::filesystem::path& als_path, std::filesystem::path dxcc_path)
 {
-    // if (argc > 3 || argc < 2) {
-    //     std::cout << "Usage: als2dxcc <input.als> [output.dxcc]" << std::endl;
-    //     return 1;
-    // }
-
-    // std::filesystem::path _als_path(argv[1]);
-    // if (!std::filesystem::exists(_als_path)) {
-    //     std::cerr << "Error: Ableton Live Set " << _als_path << " does not exist" << std::endl;
-    //     return 2;
-    // }
-
-    // std::filesystem::path _dxcc_path;
-    // if (argc == 2) {
-    //     _dxcc_path = _als_path;
-    //     _dxcc_path.replace_extension(".dxcc");
-    // } else {
-    //     _dxcc_path = argv[2];
-    // }
-
-    std::filesystem::path _als_path("C:/Users/adri/Desktop/Untitled.als");
-    std::filesystem::path _dxcc_path("C:/Users/adri/Desktop/untitled.dxcc");
-
-    std::ifstream _als_stream(_als_path, std::ios::binary);
-    std::ofstream _dxcc_stream(_dxcc_path, std::ios::binary);
-    bool _as_json = _dxcc_path.extension() == ".json";
+    bool _as_json = dxcc_path.extension() == ".json";
     if (!_as_json) {
-        _dxcc_path.replace_extension(".dxcc");
+        dxcc_path.replace_extension(".dxcc");
     }
 
+    std::ifstream _als_stream(als_path, std::ios::binary);
+    std::ofstream _dxcc_stream(dxcc_path, std::ios::binary);
     try {
         fmtals::project _als_project;
         fmtals::version _als_version;
         fmtals::import_project(_als_stream, _als_project, _als_version);
-        fmtdxc::project _dxc_project = rtdxc::detail::convert_from_als(_als_project);
+        fmtdxc::project _dxc_project = rtdxc::detail::convert_from_als(std::move(_als_project));
         fmtdxc::project_container _container(_dxc_project);
         fmtdxc::export_container(_dxcc_stream, _container, fmtdxc::version::alpha, _as_json);
     } catch (const std::exception& e) {
         std::cerr << e.what() << '\n';
+        return 3;
+    }
+    return 0;
+}
+
+}
+
+int main(int argc, char* argv[])
+{
+    std::size_t _job_count = 0;
+    std::vector<std::string> _arguments;
+    for (int _arg_index = 1; _arg_index < argc; _arg_index++) {
+        const std::string _argument = argv[_arg_index];
+        if (_argument == "--jobs" && _arg_index + 1 < argc) {
+            _job_count = std::stoul(argv[++_arg_index]);
+        } else {
+            _arguments.push_back(_argument);
+        }
+    }
+    if (_arguments.empty() || _arguments.size() > 2) {
+        print_usage();
+        return 1;
+    }
+
+    std::filesystem::path _input_path(_arguments[0]);
+    if (!std::filesystem::exists(_input_path)) {
+        std::cerr << "Error: " << _input_path << " does not exist" << std::endl;
+        return 2;
+    }
+
+    if (std::filesystem::is_directory(_input_path)) {
+        const std::filesystem::path _collection_directory_path = _arguments.size() == 2 ? std::filesystem::path(_arguments[1]) : _input_path;
+        if (!std::filesystem::is_directory(_collection_directory_path)) {
+            std::cerr << "Error: collection directory " << _collection_directory_path << " does not exist" << std::endl;
+            return 2;
+        }
+        return convert_directory(_input_path, _collection_directory_path, _job_count);
+    }
+
+    std::filesystem::path _dxcc_path;
+    if (_arguments.size() == 1) {
+        _dxcc_path = _input_path;
+        _dxcc_path.replace_extension(".dxcc");
+    } else {
+        _dxcc_path = _arguments[1];
     }
-}
\ No newline at end of file
+    return convert_file(_input_path, _dxcc_path);
+}
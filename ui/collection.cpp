@@ -94,10 +94,8 @@ enum struct collection_columns {
 
 void scan_project(const std::filesystem::path& container_path, project_info& info)
 {
-    fmtdxc::version _version;
     fmtdxc::project_container _container;
-    std::ifstream _container_stream(container_path, std::ios::binary);
-    import_container(_container_stream, _container, _version);
+    rtdxc::detail::load_container(container_path, _container); // journaled sessions leave their latest commits next to the container
     info.commits = _container.get_commits();
     info.applied = _container.get_applied_count();
 
@@ -110,6 +108,12 @@ void scan_project(const std::filesystem::path& container_path, project_info& inf
 #endif
 }
 
+// Journals and the temporary files of a container rewrite sit next to the containers
+[[nodiscard]] bool is_container_path(const std::filesystem::path& path)
+{
+    return path.extension() == ".dxcc";
+}
+
 void watch_containers()
 {
     if (last_collection_directory_path != global_settings.collection_directory_path) {
@@ -118,6 +122,9 @@ void watch_containers()
         collection_watcher.reset();
 
         for (const std::filesystem::directory_entry& _container_entry : std::filesystem::recursive_directory_iterator(global_settings.collection_directory_path)) {
+            if (!is_container_path(_container_entry.path())) {
+                continue;
+            }
             std::pair<std::filesystem::path, project_info>& _container = global_containers.emplace_back();
             _container.first = _container_entry.path();
             scan_project(_container.first, _container.second);
@@ -126,12 +133,16 @@ void watch_containers()
         collection_watcher = std::make_unique<rtdxc::detail::directory_watcher>(global_settings.collection_directory_path);
 
         collection_watcher->on_creation([](const std::filesystem::path& _created_container_path) {
+            if (!is_container_path(_created_container_path)) {
+                return;
+            }
             std::pair<std::filesystem::path, project_info>& _created_container = global_containers.emplace_back();
             _created_container.first = _created_container_path;
             scan_project(_created_container_path, _created_container.second);
         });
 
-        collection_watcher->on_modification([](const std::filesystem::path& _modified_container_path) {
+        collection_watcher->on_modification([](const std::filesystem::path& _modified_path) {
+            const std::filesystem::path _modified_container_path = _modified_path.extension() == ".journal" ? std::filesystem::path(_modified_path).replace_extension() : _modified_path;
             unsigned int _index = 0;
             for (const std::pair<std::filesystem::path, project_info>& _container : global_containers) {
                 if (_container.first == _modified_container_path) {
@@ -1,6 +1,7 @@
 #include "controls.hpp"
 #include "collection.hpp"
 #include "core/base64.hpp"
+#include "core/dialog.hpp"
 #include "core/imguid.hpp"
 #include "settings.hpp"
 
@@ -9,6 +10,7 @@
 #include <imgui_internal.h>
 #include <misc/cpp/imgui_stdlib.h>
 
+#include <atomic>
 #include <future>
 
 namespace {
@@ -22,7 +24,14 @@ static bool is_p2p_endpoints_arrived;
 static const char* p2p_client_modal_id = IMGUID("Join a P2P session");
 
 static const char* daw_loading_modal_id = IMGUID("Opening DAW");
-static std::future<void> daw_loading_future = {};
+static std::future<rtdxc::local_session> daw_loading_future = {};
+static std::atomic<std::size_t> daw_loading_done_count = 0;
+static std::size_t daw_loading_total_count = 0;
+
+static const char* import_modal_id = IMGUID("Importing sets");
+static std::future<std::vector<rtdxc::import_result>> import_future = {};
+static std::atomic<std::size_t> import_done_count = 0;
+static std::size_t import_total_count = 0;
 
 [[nodiscard]] std::string format_type(const natp2p::endpoint_type type)
 {
@@ -45,9 +54,38 @@ static std::future<void> daw_loading_future = {};
         + ":" + std::to_string(endpoint.data.external_port);
 }
 
+void open_local_session(const std::optional<std::filesystem::path>& container_path, const std::function<std::optional<std::filesystem::path>()>& exit_callback)
+{
+    daw_loading_total_count = container_path ? 7 : 4; // a new session has no container to import, convert and export
+    daw_loading_done_count = 0;
+    rtdxc::session_options _options;
+    _options.stage_callback = [](const rtdxc::session_stage_timing&) {
+        daw_loading_done_count++;
+    };
+    daw_loading_future = rtdxc::local_session::open(
+        global_settings.daws_settings[global_selected_daw_index].version,
+        global_settings.daws_settings[global_selected_daw_index].executable_path,
+        container_path, exit_callback, _options);
+    ImGui::OpenPopup(daw_loading_modal_id);
+}
+
 void draw_import_control()
 {
     if (ImGui::Button(IMGUID("Import"))) {
+        const std::optional<std::filesystem::path> _directory_path = pick_directory_dialog(std::filesystem::current_path());
+        if (_directory_path) {
+            std::vector<std::filesystem::path> _als_paths = rtdxc::find_als_sets(_directory_path.value());
+            import_total_count = _als_paths.size();
+            import_done_count = 0;
+            rtdxc::import_options _options;
+            _options.progress_callback = [](const rtdxc::import_result&) {
+                import_done_count++;
+            };
+            import_future = std::async(std::launch::async, [_als_paths = std::move(_als_paths), _options]() {
+                return rtdxc::import_many(_als_paths, global_settings.collection_directory_path, _options);
+            });
+            ImGui::OpenPopup(import_modal_id);
+        }
     }
     ImGui::SameLine();
 }
@@ -90,15 +128,9 @@ void draw_daw_selection_control()
 void draw_new_control()
 {
     if (ImGui::Button(IMGUID("New"))) {
-        daw_loading_future = std::async([]() {
-            global_session = std::make_unique<rtdxc::session>(rtdxc::local_session(
-                global_settings.daws_settings[global_selected_daw_index].version,
-                global_settings.daws_settings[global_selected_daw_index].executable_path,
-                std::nullopt, []() {
-                    return ""; // TODO MODAL
-                }));
+        open_local_session(std::nullopt, []() {
+            return ""; // TODO MODAL
         });
-        ImGui::OpenPopup(daw_loading_modal_id);
     }
     ImGui::SameLine();
 }
@@ -135,12 +167,9 @@ void draw_open_control()
     }
     if (ImGui::Button(IMGUID("Open"))) {
         const std::filesystem::path _selected_container_path = global_containers[global_selected_container_index.value()].first;
-        global_session = std::make_unique<rtdxc::session>(rtdxc::local_session(
-            global_settings.daws_settings[global_selected_daw_index].version,
-            global_settings.daws_settings[global_selected_daw_index].executable_path,
-            _selected_container_path, [_selected_container_path]() {
-                return _selected_container_path;
-            }));
+        open_local_session(_selected_container_path, [_selected_container_path]() {
+            return _selected_container_path;
+        });
     }
     if (!global_selected_container_index) {
         ImGui::EndDisabled();
@@ -284,9 +313,38 @@ void draw_daw_loading_modal()
         ImGui::PushTextWrapPos(ImGui::GetCursorPos().x + _wrap_width);
         ImGui::TextUnformatted(_text.c_str());
         ImGui::PopTextWrapPos();
+        ImGui::ProgressBar(static_cast<float>(daw_loading_done_count.load()) / static_cast<float>(daw_loading_total_count), ImVec2(-FLT_MIN, 0.f));
 
         if (daw_loading_future.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
-            daw_loading_future.get();
+            global_session = std::make_unique<rtdxc::session>(daw_loading_future.get());
+            ImGui::CloseCurrentPopup();
+        }
+
+        ImGui::EndPopup();
+    }
+}
+
+void draw_import_modal()
+{
+    const float _modal_width = 400.f;
+    const ImVec2 _viewport_center = ImGui::GetMainViewport()->GetCenter();
+    ImGui::SetNextWindowPos(_viewport_center, ImGuiCond_Always, ImVec2(0.5f, 0.5f));
+    ImGui::SetNextWindowSize(ImVec2(_modal_width, 0.f), ImGuiCond_Always);
+    ImGui::SetNextWindowSizeConstraints(ImVec2(_modal_width, 0.f), ImVec2(_modal_width, FLT_MAX));
+
+    if (ImGui::BeginPopupModal(import_modal_id, nullptr, ImGuiWindowFlags_NoMove | ImGuiWindowFlags_NoResize)) {
+
+        const std::string _text = "Importing sets into the collection... "
+            + std::to_string(import_done_count.load()) + " / " + std::to_string(import_total_count);
+        ImGui::TextUnformatted(_text.c_str());
+        ImGui::ProgressBar(import_total_count ? static_cast<float>(import_done_count.load()) / static_cast<float>(import_total_count) : 1.f, ImVec2(-FLT_MIN, 0.f));
+
+        if (import_future.wait_for(std::chrono::milliseconds(0)) == std::future_status::ready) {
+            for (const rtdxc::import_result& _result : import_future.get()) {
+                if (_result.error) {
+                    std::cerr << "Failed to import " << _result.als_path << ": " << _result.error.value() << std::endl;
+                }
+            }
             ImGui::CloseCurrentPopup();
         }
 
@@ -331,6 +389,7 @@ void draw_controls()
 
         draw_p2p_host_modal();
         draw_daw_loading_modal();
+        draw_import_modal();
         ImGui::End();
     }
 